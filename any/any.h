@@ -37,9 +37,34 @@ class any_copyable_function;
 	mireo::any_copyable_function<int(int, char**)> main1 = &main;
 	auto main2 = main1;
 
+template <std::size_t InlineSize, typename DefaultAllocator, auto&... CPOs>
+class basic_any;
+
+	`mireo::any` with an inline buffer of InlineSize bytes instead of 4 pointers, and
+	objects that don't fit allocated with DefaultAllocator. Any wrapper also takes an
+	allocator for one object, e.g. to keep all objects of an owner in one arena:
+
+	std::pmr::monotonic_buffer_resource arena;
+	mireo::any<cpo> a(std::allocator_arg, std::pmr::polymorphic_allocator<>(&arena), big_object);
+
+	mireo::pmr::any and mireo::pmr::any_function allocate with the polymorphic allocator
+	by default.
+
+template <typename Any, typename T>
+constexpr bool stored_inline_v;
+
+	Whether `Any` stores a T in its inline buffer, without allocating:
+
+	static_assert(mireo::stored_inline_v<mireo::any<cpo>, my_object>);
+
+	Define MIREO_ANY_HEAP_WARNINGS to have the compiler warn at every wrapping of an
+	object that is allocated, with the object's type in the instantiation notes.
+
 */
 
 #include <memory>
+#include <memory_resource>
+#include <utility>
 #include "tag_invoke.h"
 
 namespace mireo {
@@ -460,6 +485,17 @@ public:
 template <typename T, typename Allocator, typename... CPOs>
 using any_heap_allocated_storage = typename _any_heap_allocated_storage<T, Allocator>::template type<CPOs...>;
 
+// Called for every object wrapped in heap-allocated storage, so that with
+// MIREO_ANY_HEAP_WARNINGS the compiler names the types that spill out of the
+// inline buffer.
+
+template <typename T, std::size_t InlineSize>
+#ifdef MIREO_ANY_HEAP_WARNINGS
+[[deprecated("mireo::any: the object doesn't fit the inline buffer and is allocated, see T and InlineSize")]]
+#endif
+constexpr void _heap_allocated() noexcept {
+}
+
 //
 // _destroy_cpo / _move_construct_cpo / _copy_construct_cpo / _invoke_cpo
 //
@@ -566,6 +602,11 @@ class _any_object<InlineSize, DefaultAllocator, IsCopyable, CPOs...>::type :
 	alignas(inline_alignment) std::byte _storage[inline_size];
 
 public:
+	static constexpr std::size_t inline_buffer_size = _any_object::inline_size;
+
+	template <typename T>
+	static constexpr bool stored_inline_v = _any_object::can_be_stored_inplace_v<T>;
+
 	type() = default;
 
 	template <typename T> requires (!std::is_same_v<type, std::remove_cvref_t<T>>)
@@ -604,6 +645,7 @@ public:
 	explicit type(std::allocator_arg_t, Alloc alloc, std::in_place_type_t<T>, Args&&... args) :
 		_vtable(vtable_t::template inst<detail::any_heap_allocated_storage<T, Alloc, CPOs...>>())
 	{
+		detail::_heap_allocated<T, inline_buffer_size>();
 		::new (static_cast<void*>(&_storage)) detail::any_heap_allocated_storage<T, Alloc, CPOs...>(
 			std::allocator_arg,
 			std::move(alloc),
@@ -688,6 +730,7 @@ public:
 			destroy(detail::_destroy_cpo{ }, &_storage);
 		}
 		using value_type = detail::any_heap_allocated_storage<std::remove_cvref_t<T>, DefaultAllocator, CPOs...>;
+		detail::_heap_allocated<std::remove_cvref_t<T>, inline_buffer_size>();
 		::new (static_cast<void*>(&_storage)) value_type(
 			std::allocator_arg,
 			DefaultAllocator { },
@@ -817,6 +860,33 @@ using any_copyable_function_t = basic_any_copyable_function_t<
 template <typename Sig, auto&... CPOs>
 using any_copyable_function = any_copyable_function_t<Sig, mireo::tag_t<CPOs>...>;
 
+//
+// pmr::any / pmr::any_function
+//
+
+namespace pmr {
+
+template <typename... CPOs>
+using any_t = basic_any_t<4 * sizeof(void*), std::pmr::polymorphic_allocator<std::byte>, CPOs...>;
+
+template <auto&... CPOs>
+using any = any_t<mireo::tag_t<CPOs>...>;
+
+template <typename Sig, typename... CPOs>
+using any_function_t = basic_any_function_t<Sig, 4 * sizeof(void*), std::pmr::polymorphic_allocator<std::byte>, CPOs...>;
+
+template <typename Sig, auto&... CPOs>
+using any_function = any_function_t<Sig, mireo::tag_t<CPOs>...>;
+
+} // namespace pmr
+
+//
+// stored_inline_v
+//
+
+template <typename Any, typename T>
+inline constexpr bool stored_inline_v = Any::template stored_inline_v<std::remove_cvref_t<T>>;
+
 //
 // any_invoke
 //
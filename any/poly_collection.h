@@ -0,0 +1,251 @@
+#pragma once
+
+/**
+
+Synopsis:
+
+template <typename... CPOs>
+class poly_collection;
+
+	A sequence of objects of any types that customise the CPOs, like a vector of
+	mireo::any<CPOs...>, which keeps the objects of every concrete type together, in a
+	segment of their own. for_each() and transform() call a CPO on all the objects with
+	one indirect call per segment, which loops over the segment with the CPO resolved at
+	compile time, instead of an indirect call per object.
+
+	The objects are visited segment by segment, in the order their segments were made,
+	and in the order they were inserted within a segment. The CPOs must take the object
+	as their first argument.
+
+	mireo::poly_collection<sig_assemble, sig_reset> asms;
+	asms.insert(sig_last<int64_t>(sig));
+	asms.insert(sig_avg<double>(other_sig));
+	asms.for_each(sig_reset);
+	asms.transform(sig_assemble, vals.data(), mux_val, fd); // vals.size() == asms.size()
+
+template <typename... CPOs>
+class ordered_poly_collection;
+
+	A poly_collection that keeps the order of insertion: transform() stores the result
+	of the i-th inserted object to out[i]. The CPO is still called segment by segment,
+	so calls with side effects shared by the objects happen in segment order.
+
+*/
+
+#include <span>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include "any.h"
+
+namespace mireo {
+
+namespace detail {
+
+template <typename T>
+inline constexpr char _poly_type_id = 0;
+
+//
+// _poly_batch_entry
+//
+// The batched form of a CPO: calls it on the objects of a std::vector<T>, storing the
+// results in out[pos[i]], or in out[i] without positions, or discarding them without
+// `out`. Returns the number of objects.
+//
+
+template <typename Sig>
+struct _poly_strip_noexcept {
+	using type = Sig;
+};
+
+template <typename Ret, typename... Args>
+struct _poly_strip_noexcept<Ret(Args...) noexcept> {
+	using type = Ret(Args...);
+};
+
+template <typename CPO, typename Sig = typename _poly_strip_noexcept<typename CPO::type_erased_signature_t>::type>
+struct _poly_batch_entry;
+
+template <typename CPO, typename Ret, typename This, typename... Args>
+struct _poly_batch_entry<CPO, Ret(This, Args...)> {
+	static_assert(is_this_v<This>, "poly_collection: CPOs must take the object as their first argument");
+	static_assert(!std::is_reference_v<Ret>, "poly_collection: CPOs can't return references");
+
+	using fn_t = std::size_t(base_cpo_t<CPO>, void* objects, const uint32_t* pos, Ret* out, Args... args);
+
+	template <typename T>
+	static std::size_t call(base_cpo_t<CPO> cpo, void* objects, const uint32_t* pos, Ret* out, Args... args) {
+		auto& objs = *static_cast<std::vector<T>*>(objects);
+		for (std::size_t i = 0; i < objs.size(); ++i) {
+			if constexpr (std::is_void_v<Ret>)
+				cpo(replace_this<This>::get(nullptr, objs[i]), args...);
+			else if (!out)
+				cpo(replace_this<This>::get(nullptr, objs[i]), args...);
+			else
+				out[pos ? pos[i] : i] = cpo(replace_this<This>::get(nullptr, objs[i]), args...);
+		}
+		return objs.size();
+	}
+
+	fn_t* fn;
+};
+
+template <typename... CPOs>
+struct _poly_batch_table : _poly_batch_entry<CPOs>... {
+	template <typename T>
+	static const _poly_batch_table* inst() noexcept {
+		static constexpr _poly_batch_table table { _poly_batch_entry<CPOs> { &_poly_batch_entry<CPOs>::template call<T> }... };
+		return &table;
+	}
+
+	template <typename CPO>
+	auto get() const noexcept {
+		return static_cast<const _poly_batch_entry<CPO>&>(*this).fn;
+	}
+};
+
+//
+// _poly_collection
+//
+
+template <bool Ordered, typename... CPOs>
+class _poly_collection {
+	struct segment_base {
+		const void* type_id;
+		const _poly_batch_table<CPOs...>* batch;
+		void* storage; // the std::vector<T> of the segment, passed to the batch table
+		std::vector<uint32_t> positions; // of the objects in insertion order, only if Ordered
+
+		segment_base(const void* type_id, const _poly_batch_table<CPOs...>* batch, void* storage) :
+			type_id(type_id), batch(batch), storage(storage)
+		{
+		}
+		virtual ~segment_base() = default;
+
+		virtual std::size_t byte_size() const noexcept = 0;
+	};
+
+	template <typename T>
+	struct typed_segment final : segment_base {
+		std::vector<T> objects;
+
+		typed_segment() : segment_base(&_poly_type_id<T>, _poly_batch_table<CPOs...>::template inst<T>(), &objects) {
+		}
+
+		std::size_t byte_size() const noexcept override {
+			return sizeof(*this) + objects.capacity() * sizeof(T) + this->positions.capacity() * sizeof(uint32_t);
+		}
+	};
+
+	std::vector<std::unique_ptr<segment_base>> _segments;
+	std::size_t _size = 0;
+
+public:
+	_poly_collection() = default;
+
+	_poly_collection(_poly_collection&& other) noexcept :
+		_segments(std::move(other._segments)), _size(std::exchange(other._size, 0))
+	{
+	}
+
+	_poly_collection& operator=(_poly_collection&& other) noexcept {
+		_segments = std::move(other._segments);
+		_size = std::exchange(other._size, 0);
+		return *this;
+	}
+
+	template <typename T>
+	std::remove_cvref_t<T>& insert(T&& object) {
+		return emplace<std::remove_cvref_t<T>>(static_cast<T&&>(object));
+	}
+
+	template <typename T, typename... Args>
+	T& emplace(Args&&... args) {
+		auto& seg = segment_of<T>();
+		T& rv = seg.objects.emplace_back(static_cast<Args&&>(args)...);
+		if constexpr (Ordered)
+			seg.positions.push_back(uint32_t(_size));
+		++_size;
+		return rv;
+	}
+
+	std::size_t size() const noexcept { return _size; }
+	bool empty() const noexcept { return _size == 0; }
+	std::size_t segment_count() const noexcept { return _segments.size(); }
+
+	void clear() noexcept {
+		_segments.clear();
+		_size = 0;
+	}
+
+	// The objects of type T, in insertion order.
+	template <typename T>
+	std::span<T> segment() noexcept {
+		for (auto& seg : _segments)
+			if (seg->type_id == &_poly_type_id<T>)
+				return static_cast<typed_segment<T>&>(*seg).objects;
+		return {};
+	}
+
+	// Calls `cpo` on every object, discarding the results. The arguments are passed to
+	// every segment, so they're never moved from.
+	template <typename CPO, typename... Args>
+	void for_each(CPO cpo, Args&&... args) {
+		static_assert((std::is_same_v<CPO, CPOs> || ...), "poly_collection: not one of the collection's CPOs");
+		for (auto& seg : _segments)
+			seg->batch->template get<CPO>()(cpo, seg->storage, nullptr, nullptr, args...);
+	}
+
+	// Calls `cpo` on every object and stores the results to out[0, size()), in the order
+	// the objects are visited, or in insertion order if Ordered.
+	template <typename CPO, typename Ret, typename... Args>
+	void transform(CPO cpo, Ret* out, Args&&... args) {
+		static_assert((std::is_same_v<CPO, CPOs> || ...), "poly_collection: not one of the collection's CPOs");
+		for (auto& seg : _segments) {
+			const uint32_t* pos = Ordered ? seg->positions.data() : nullptr;
+			std::size_t n = seg->batch->template get<CPO>()(cpo, seg->storage, pos, out, args...);
+			if constexpr (!Ordered)
+				out += n;
+		}
+	}
+
+	// heap and object bytes of the segments
+	std::size_t byte_size() const noexcept {
+		std::size_t rv = _segments.capacity() * sizeof(_segments[0]);
+		for (const auto& seg : _segments)
+			rv += seg->byte_size();
+		return rv;
+	}
+
+private:
+	template <typename T>
+	typed_segment<T>& segment_of() {
+		for (auto& seg : _segments)
+			if (seg->type_id == &_poly_type_id<T>)
+				return static_cast<typed_segment<T>&>(*seg);
+		_segments.push_back(std::make_unique<typed_segment<T>>());
+		return static_cast<typed_segment<T>&>(*_segments.back());
+	}
+};
+
+}  // namespace detail
+
+//
+// poly_collection / ordered_poly_collection
+//
+
+template <typename... CPOs>
+using poly_collection_t = detail::_poly_collection<false, CPOs...>;
+
+template <auto&... CPOs>
+using poly_collection = poly_collection_t<mireo::tag_t<CPOs>...>;
+
+template <typename... CPOs>
+using ordered_poly_collection_t = detail::_poly_collection<true, CPOs...>;
+
+template <auto&... CPOs>
+using ordered_poly_collection = ordered_poly_collection_t<mireo::tag_t<CPOs>...>;
+
+} // namespace mireo
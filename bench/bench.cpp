@@ -0,0 +1,488 @@
+/*
+	Microbenchmarks for the hot paths of the library.
+
+	Every benchmark is run until it has taken at least `min_time`, and the results are
+	printed to stdout as a JSON array, one object per benchmark:
+
+	{ "name": "...", "iterations": N, "ns_per_op": ..., "ops_per_sec": ..., "bytes_per_sec": ... }
+
+	Pass a substring as the first argument to run only the benchmarks whose name contains it.
+*/
+
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "any/any.h"
+#include "any/poly_collection.h"
+#include "can/can_codec.h"
+#include "can/frame_packet.h"
+#include "dbc/dbc_parser.h"
+#include "dbc/dbc_grammar.h"
+#include "dbc/dbc_cache.h"
+#include "dbc/dbc_parallel.h"
+#include "dbc/dbc_file.h"
+#include "v2c/v2c_transcoder.h"
+#include "v2c/v2c_session.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+constexpr auto min_time = std::chrono::milliseconds(200);
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+template <typename T>
+inline void do_not_optimize(const T& value) {
+	const volatile void* sink = &value;
+	(void)sink;
+	_ReadWriteBarrier();
+}
+#else // _MSC_VER
+template <typename T>
+inline void do_not_optimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+#endif // _MSC_VER
+
+struct bench_result {
+	std::string name;
+	uint64_t iterations;
+	double ns_per_op;
+	double bytes_per_sec;
+};
+
+class bench_runner {
+	std::string _filter;
+	std::vector<bench_result> _results;
+
+public:
+	explicit bench_runner(std::string filter) : _filter(std::move(filter)) {}
+
+	// `fn(n)` runs n operations; `bytes_per_op` is reported as throughput if non-zero
+	template <typename F>
+	void run(const std::string& name, F&& fn, size_t bytes_per_op = 0) {
+		if (name.find(_filter) == std::string::npos)
+			return;
+
+		uint64_t n = 1;
+		bench_clock::duration elapsed {};
+		while (true) {
+			auto start = bench_clock::now();
+			fn(n);
+			elapsed = bench_clock::now() - start;
+			if (elapsed >= min_time || n >= (1ull << 40))
+				break;
+			n *= elapsed < min_time / 100 ? 10 : 2;
+		}
+
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count() / n;
+		_results.push_back({ name, n, ns, bytes_per_op ? bytes_per_op * 1e9 / ns : 0 });
+		fprintf(stderr, "%-48s %12.2f ns/op\n", name.c_str(), ns);
+	}
+
+	void print_json() const {
+		printf("[\n");
+		for (size_t i = 0; i < _results.size(); ++i) {
+			const auto& r = _results[i];
+			printf(
+				"  { \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, \"bytes_per_sec\": %.1f }%s\n",
+				r.name.c_str(), (unsigned long long)r.iterations, r.ns_per_op, 1e9 / r.ns_per_op, r.bytes_per_sec,
+				i + 1 < _results.size() ? "," : ""
+			);
+		}
+		printf("]\n");
+	}
+};
+
+// A synthetic DBC with `n_msgs` messages of eight signals each, comments,
+// value descriptions and the attributes v2c_transcoder uses.
+static std::string synthetic_dbc(size_t n_msgs) {
+	std::string dbc =
+		"VERSION \"1.0\"\n\nNS_ :\n\tCM_\n\tBA_DEF_\n\tBA_\n\tVAL_\n\nBS_:\n\nBU_: ECU V2C\n\n";
+
+	char line[256];
+	for (size_t m = 0; m < n_msgs; ++m) {
+		snprintf(line, sizeof(line), "BO_ %zu Message%zu: 8 ECU\n", m + 1, m);
+		dbc += line;
+		for (int s = 0; s < 8; ++s) {
+			snprintf(
+				line, sizeof(line), " SG_ Sig%zu_%d : %d|8@1%c (0.5,-10) [-10|117.5] \"unit\" V2C\n",
+				m, s, s * 8, s % 2 ? '-' : '+'
+			);
+			dbc += line;
+		}
+		dbc += "\n";
+	}
+
+	dbc += "EV_ V2CTxTime: 0 [0|60000] \"ms\" 2000 1 DUMMY_NODE_VECTOR1 V2C;\n";
+	dbc += "EV_ FastGroupTxFreq: 0 [0|60000] \"ms\" 100 2 DUMMY_NODE_VECTOR1 V2C;\n\n";
+
+	for (size_t m = 0; m < n_msgs; ++m) {
+		snprintf(line, sizeof(line), "CM_ BO_ %zu \"Message %zu carries eight synthetic signals.\";\n", m + 1, m);
+		dbc += line;
+	}
+
+	dbc += "BA_DEF_ BO_ \"TxGroupFreq\" STRING ;\nBA_DEF_ SG_ \"AggType\" STRING ;\n";
+	for (size_t m = 0; m < n_msgs; ++m) {
+		for (int s = 0; s < 8; ++s) {
+			snprintf(line, sizeof(line), "BA_ \"AggType\" SG_ %zu Sig%zu_%d \"%s\";\n", m + 1, m, s, s % 2 ? "AVG" : "LAST");
+			dbc += line;
+		}
+	}
+	for (size_t m = 0; m < n_msgs; ++m) {
+		snprintf(line, sizeof(line), "BA_ \"TxGroupFreq\" BO_ %zu \"FastGroupTxFreq\";\n", m + 1);
+		dbc += line;
+	}
+
+	for (size_t m = 0; m < n_msgs; ++m) {
+		snprintf(line, sizeof(line), "VAL_ %zu Sig%zu_0 0 \"Off\" 1 \"On\" 2 \"Error\";\n", m + 1, m);
+		dbc += line;
+	}
+	return dbc;
+}
+
+struct null_interpreter {};
+
+static void bench_parser(bench_runner& br) {
+	for (size_t n_msgs : { 10, 100, 1000, 8000 }) {
+		auto dbc = synthetic_dbc(n_msgs);
+		auto suffix = "/" + std::to_string(n_msgs) + "_msgs";
+
+		br.run("parse_dbc/null" + suffix, [&](uint64_t n) {
+			null_interpreter ni;
+			for (uint64_t i = 0; i < n; ++i)
+				do_not_optimize(can::parse_dbc(dbc, std::ref(ni)));
+		}, dbc.size());
+
+		br.run("parse_dbc/v2c_transcoder" + suffix, [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) {
+				can::v2c_transcoder transcoder;
+				do_not_optimize(can::parse_dbc(dbc, std::ref(transcoder)));
+			}
+		}, dbc.size());
+
+		br.run("parse_dbc/static/null" + suffix, [&](uint64_t n) {
+			null_interpreter ni;
+			for (uint64_t i = 0; i < n; ++i)
+				do_not_optimize(can::parse_dbc(dbc, ni));
+		}, dbc.size());
+
+		br.run("parse_dbc/static/v2c_transcoder" + suffix, [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) {
+				can::v2c_transcoder transcoder;
+				do_not_optimize(can::parse_dbc(dbc, transcoder));
+			}
+		}, dbc.size());
+
+		br.run("parse_dbc/handled_sections/v2c_transcoder" + suffix, [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) {
+				can::v2c_transcoder transcoder;
+				do_not_optimize(can::parse_dbc(dbc, transcoder, can::handled_sections<can::v2c_transcoder>));
+			}
+		}, dbc.size());
+
+		br.run("parse_dbc_parallel/v2c_transcoder" + suffix, [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) {
+				can::v2c_transcoder transcoder;
+				do_not_optimize(can::parse_dbc_parallel(dbc, std::ref(transcoder)));
+			}
+		}, dbc.size());
+
+		br.run("parse_dbc_stream/64k/v2c_transcoder" + suffix, [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) {
+				can::v2c_transcoder transcoder;
+				std::istringstream in{ std::string(dbc) };
+				do_not_optimize(can::parse_dbc_stream(in, std::ref(transcoder), { .chunk_size = 64 * 1024 }));
+			}
+		}, dbc.size());
+
+		// one DBC per vehicle model at service startup
+		if (n_msgs == 100) {
+			br.run("parse_dbcs/16x/v2c_transcoder" + suffix, [&](uint64_t n) {
+				std::vector<std::string_view> srcs(16, dbc);
+				for (uint64_t i = 0; i < n; ++i) {
+					std::vector<can::v2c_transcoder> transcoders(srcs.size());
+					std::vector<can::interpreter> ipts;
+					for (auto& tc : transcoders)
+						ipts.emplace_back(std::ref(tc));
+					do_not_optimize(can::parse_dbcs(srcs, ipts));
+				}
+			}, 16 * dbc.size());
+		}
+
+		can::dbc_recorder rec;
+		can::parse_dbc(dbc, rec);
+
+		br.run("dbc_cache/replay/null" + suffix, [&](uint64_t n) {
+			null_interpreter ni;
+			for (uint64_t i = 0; i < n; ++i)
+				do_not_optimize(can::replay_dbc_records(rec.records(), std::ref(ni)));
+		}, dbc.size());
+
+		br.run("dbc_cache/replay/v2c_transcoder" + suffix, [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) {
+				can::v2c_transcoder transcoder;
+				do_not_optimize(can::replay_dbc_records(rec.records(), std::ref(transcoder)));
+			}
+		}, dbc.size());
+	}
+}
+
+// true if a signal fits in 64 bits; Motorola signals run from the MSB at
+// `start_bit` towards the next byte's bit 7
+static bool valid_layout(unsigned start_bit, unsigned size, char byte_order) {
+	if (byte_order == '1')
+		return start_bit + size <= 64;
+	unsigned bit = start_bit;
+	for (unsigned i = 1; i < size; ++i) {
+		bit = bit % 8 == 0 ? bit + 15 : bit - 1;
+		if (bit >= 64) return false;
+	}
+	return true;
+}
+
+static void bench_codec(bench_runner& br) {
+	std::vector<can::sig_codec> codecs;
+	for (char bo : { '0', '1' })
+		for (unsigned sb = 0; sb < 64; ++sb)
+			for (unsigned size = 1; size <= 64; ++size)
+				if (valid_layout(sb, size, bo))
+					codecs.emplace_back(sb, size, bo, size % 2 ? '+' : '-');
+
+	// the decoder may read up to 16 bytes past the signal's first byte
+	alignas(8) uint8_t data[24] = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0 };
+
+	br.run("sig_codec/decode/all_layouts", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			do_not_optimize(codecs[i % codecs.size()](data));
+	});
+
+	br.run("sig_codec/encode/all_layouts", [&](uint64_t n) {
+		uint8_t buff[16] = {};
+		for (uint64_t i = 0; i < n; ++i) {
+			codecs[i % codecs.size()](i * 0x9E3779B97F4A7C15ull, buff);
+			do_not_optimize(buff);
+		}
+	});
+
+	for (char bo : { '0', '1' }) {
+		can::sig_codec c16 { bo == '1' ? 16u : 23u, 16, bo, '-' };
+		std::string order = bo == '1' ? "intel" : "motorola";
+
+		br.run("sig_codec/decode/" + order + "_16bit", [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i)
+				do_not_optimize(c16(data));
+		});
+		br.run("sig_codec/encode/" + order + "_16bit", [&](uint64_t n) {
+			uint64_t buff = 0;
+			for (uint64_t i = 0; i < n; ++i) {
+				c16(i, &buff);
+				do_not_optimize(buff);
+			}
+		});
+	}
+}
+
+static void bench_transcoder(bench_runner& br) {
+	using namespace std::chrono;
+
+	std::vector<can_frame> frames(4096);
+	std::mt19937_64 rng(1);
+	for (auto& f : frames) {
+		f = {};
+		f.can_id = canid_t(1 + rng() % 64);
+		f.len = 8;
+		*(uint64_t*)f.data = rng();
+	}
+
+	can::can_time t0 { seconds(1683709842) };
+
+	// the transcoding path without metrics, as the sessions of many vehicles run it
+	br.run("v2c_session/transcode", [&](uint64_t n) {
+		can::v2c_session session(can::v2c_schema::compile(synthetic_dbc(64)));
+		for (uint64_t i = 0; i < n; ++i)
+			do_not_optimize(session.transcode(t0 + microseconds(50 * i), frames[i % frames.size()]).byte_size());
+	});
+
+	// one op fills a 64-message window (one frame per message) and publishes it
+	br.run("v2c_session/publish/64_msgs", [&](uint64_t n) {
+		can::v2c_session session(can::v2c_schema::compile(synthetic_dbc(64)));
+		size_t bytes = 0;
+		for (uint64_t i = 0; i < n; ++i) {
+			auto window = t0 + milliseconds(100 * i);
+			for (canid_t id = 1; id <= 64; ++id) {
+				can_frame cf = frames[id];
+				cf.can_id = id;
+				bytes += session.transcode(window + milliseconds(1), cf).byte_size();
+			}
+		}
+		do_not_optimize(bytes);
+	});
+
+	br.run("v2c_transcoder/transcode", [&](uint64_t n) {
+		can::v2c_transcoder tc;
+		can::parse_dbc(synthetic_dbc(64), std::ref(tc));
+		for (uint64_t i = 0; i < n; ++i)
+			do_not_optimize(tc.transcode(t0 + microseconds(50 * i), frames[i % frames.size()]).byte_size());
+	});
+}
+
+static void bench_frame_iterator(bench_runner& br) {
+	can::frame_packet fp;
+	fp.prepare(1683709842);
+	for (int i = 0; i < 4096; ++i) {
+		can_frame cf {};
+		cf.can_id = i;
+		cf.len = 8;
+		fp.append(int32_t(i));
+		fp.append(cf);
+	}
+
+	br.run("frame_iterator/4096_frames", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			uint64_t sum = 0;
+			for (const auto& [ts, frame] : fp)
+				sum += frame.can_id + ts.time_since_epoch().count();
+			do_not_optimize(sum);
+		}
+	}, fp.byte_size());
+}
+
+constexpr struct bench_apply_cpo {
+	using type_erased_signature_t = uint64_t(mireo::this_&, uint64_t);
+
+	template <typename T> requires mireo::tag_invocable<bench_apply_cpo, T&, uint64_t>
+	uint64_t operator()(T& x, uint64_t v) const {
+		return mireo::tag_invoke(*this, x, v);
+	}
+} bench_apply;
+
+struct adder {
+	uint64_t k;
+	friend uint64_t tag_invoke(bench_apply_cpo, adder& self, uint64_t v) { return v + self.k; }
+};
+
+struct multiplier {
+	uint64_t k;
+	friend uint64_t tag_invoke(bench_apply_cpo, multiplier& self, uint64_t v) { return v * self.k; }
+};
+
+// too big for mireo::any's inline buffer
+struct wide_adder {
+	uint64_t k[8];
+	friend uint64_t tag_invoke(bench_apply_cpo, wide_adder& self, uint64_t v) { return v + self.k[0]; }
+};
+
+struct virtual_op {
+	virtual ~virtual_op() = default;
+	virtual uint64_t apply(uint64_t v) = 0;
+};
+
+struct virtual_adder : virtual_op {
+	uint64_t k;
+	explicit virtual_adder(uint64_t k) : k(k) {}
+	uint64_t apply(uint64_t v) override { return v + k; }
+};
+
+struct virtual_multiplier : virtual_op {
+	uint64_t k;
+	explicit virtual_multiplier(uint64_t k) : k(k) {}
+	uint64_t apply(uint64_t v) override { return v * k; }
+};
+
+static void bench_any(bench_runner& br) {
+	constexpr size_t count = 1024;
+	std::mt19937 rng(1);
+
+	std::vector<mireo::any<bench_apply>> anys;
+	std::vector<std::unique_ptr<virtual_op>> virtuals;
+	mireo::poly_collection<bench_apply> batched;
+	for (size_t i = 0; i < count; ++i) {
+		if (rng() % 2) {
+			anys.emplace_back(adder{ i });
+			virtuals.emplace_back(new virtual_adder(i));
+			batched.insert(adder{ i });
+		}
+		else {
+			anys.emplace_back(multiplier{ i | 1 });
+			virtuals.emplace_back(new virtual_multiplier(i | 1));
+			batched.insert(multiplier{ i | 1 });
+		}
+	}
+
+	br.run("dispatch/mireo_any", [&](uint64_t n) {
+		uint64_t v = 1;
+		for (uint64_t i = 0; i < n; ++i)
+			v = bench_apply(anys[i % count], v);
+		do_not_optimize(v);
+	});
+
+	br.run("dispatch/virtual_call", [&](uint64_t n) {
+		uint64_t v = 1;
+		for (uint64_t i = 0; i < n; ++i)
+			v = virtuals[i % count]->apply(v);
+		do_not_optimize(v);
+	});
+
+	// one op calls every object once, one at a time or a segment of a type at a time
+	std::vector<uint64_t> out(count);
+	br.run("dispatch/mireo_any/1024_objs", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			for (size_t j = 0; j < count; ++j)
+				out[j] = bench_apply(anys[j], i);
+		}
+		do_not_optimize(out[0]);
+	});
+
+	br.run("dispatch/poly_collection/1024_objs", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i)
+			batched.transform(bench_apply, out.data(), i);
+		do_not_optimize(out[0]);
+	});
+
+	// wrapping objects that spill out of the inline buffer, one heap allocation each or
+	// all from the arena of their owner
+	std::vector<mireo::any<bench_apply>> wide;
+	wide.reserve(count);
+	br.run("construct/mireo_any/heap", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			if (wide.size() == count)
+				wide.clear();
+			wide.emplace_back(wide_adder{ { i } });
+		}
+		do_not_optimize(wide.back());
+	});
+	wide.clear();
+
+	std::pmr::monotonic_buffer_resource arena;
+	br.run("construct/mireo_any/pmr_arena", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			if (wide.size() == count) {
+				wide.clear();
+				arena.release();
+			}
+			wide.emplace_back(std::allocator_arg, std::pmr::polymorphic_allocator<>(&arena), wide_adder{ { i } });
+		}
+		do_not_optimize(wide.back());
+	});
+	wide.clear();
+}
+
+int main(int argc, char** argv) {
+	bench_runner br(argc > 1 ? argv[1] : "");
+
+	bench_parser(br);
+	bench_codec(br);
+	bench_transcoder(br);
+	bench_frame_iterator(br);
+	bench_any(br);
+
+	br.print_json();
+	return 0;
+}
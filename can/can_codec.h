@@ -4,17 +4,20 @@
 #include <boost/endian.hpp>
 #include <variant>
 #include <string>
+#include <cstring>
 
 #include "can_kernel.h"
 
 namespace can {
 
+// 10 bytes, so that a sig_layout, the codec with its multiplexer value, is 16
 class sig_codec {
-	using order = boost::endian::order;
-	unsigned _start_bit, _bit_size;
+	enum class order : uint8_t { big, little };
+	uint16_t _start_bit;
+	uint8_t _bit_size;
 	order _byte_order;
 	char _sign_type;
-	unsigned _byte_pos, _bit_pos, _last_bit_pos, _nbytes;
+	uint8_t _byte_pos, _bit_pos, _last_bit_pos, _nbytes;
 public:
 	sig_codec(unsigned sb, unsigned bs, char bo, char st) :
 		_start_bit(sb), _bit_size(bs),
@@ -63,6 +66,14 @@ public:
 		return val;
 	}
 
+	// Decodes from the 8 data bytes of a frame. They're copied into a zero-padded buffer,
+	// since the 8-byte load above starts at the signal's first byte.
+	uint64_t decode(uint64_t data) const {
+		uint8_t padded[16] = {};
+		std::memcpy(padded, &data, sizeof(data));
+		return (*this)(padded);
+	}
+
 	void operator()(uint64_t raw, void* buffer) const {
 		char* b = reinterpret_cast<char*>(buffer);
 
@@ -102,6 +113,8 @@ public:
 	}
 
 	char sign_type() const { return _sign_type; }
+
+	bool operator==(const sig_codec&) const = default;
 };
 
 template <typename T>
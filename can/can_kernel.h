@@ -47,11 +47,15 @@
 
 #include <stdint.h>
 
+#ifdef __linux__
+#include <linux/types.h> /* same typedefs, already pulled in by some system headers */
+#else // __linux__
 typedef int32_t __s32;
 typedef uint32_t __u32;
 typedef uint8_t __u8;
 typedef uint16_t __u16;
 typedef uint64_t __u64;
+#endif // __linux__
 
 /* controller area network (CAN) kernel definitions */
 
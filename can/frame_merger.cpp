@@ -0,0 +1,110 @@
+#include <queue>
+#include <algorithm>
+
+#include "frame_merger.h"
+
+namespace can {
+
+frame_merger::frame_merger(size_t sources, const frame_merger_options& opts) :
+	_opts(opts)
+{
+	_sources.reserve(sources);
+	for (size_t i = 0; i < sources; ++i) {
+		_sources.push_back(std::make_unique<source>());
+		_sources.back()->newest = can_time::min();
+	}
+}
+
+void frame_merger::push(size_t source, can_time stamp, can_frame frame) {
+	auto& s = *_sources[source];
+	std::lock_guard lock(s.lock);
+	s.inbox.emplace_back(stamp, frame);
+}
+
+void frame_merger::push(size_t source, std::span<const timed_frame> frames) {
+	auto& s = *_sources[source];
+	std::lock_guard lock(s.lock);
+	s.inbox.insert(s.inbox.end(), frames.begin(), frames.end());
+}
+
+void frame_merger::take_inboxes() {
+	auto by_stamp = [](const timed_frame& a, const timed_frame& b) { return a.first < b.first; };
+
+	for (size_t i = 0; i < _sources.size(); ++i) {
+		auto& s = *_sources[i];
+		{
+			std::lock_guard lock(s.lock);
+			std::swap(s.inbox, _scratch);
+		}
+		_stats.frames_in += _scratch.size();
+
+		for (auto& tf : _scratch) {
+			if (_popped && tf.first < _last_out) {
+				++_stats.late;
+				continue;
+			}
+			frame_bus(tf.second, uint8_t(i));
+			if (s.seen && tf.first < s.newest) {
+				++_stats.reordered;
+				s.pending.insert(std::upper_bound(s.pending.begin(), s.pending.end(), tf, by_stamp), tf);
+				continue;
+			}
+			s.pending.push_back(tf);
+			s.newest = tf.first;
+			s.seen = true;
+		}
+		_newest = std::max(_newest, s.newest);
+		_scratch.clear();
+	}
+}
+
+size_t frame_merger::merge(std::vector<timed_frame>& out, can_time release_before, bool all) {
+	// the oldest pending frame of every source, ties go to the lower source
+	using head = std::pair<can_time, size_t>;
+	std::priority_queue<head, std::vector<head>, std::greater<head>> heads;
+
+	// a source without pending frames may still push frames as old as its newest one
+	auto empty_limit = can_time::max();
+	for (size_t i = 0; i < _sources.size(); ++i) {
+		auto& s = *_sources[i];
+		if (s.pending.empty())
+			empty_limit = std::min(empty_limit, s.newest);
+		else
+			heads.emplace(s.pending.front().first, i);
+	}
+
+	size_t n = 0;
+	while (!heads.empty()) {
+		auto [stamp, i] = heads.top();
+		if (!all && stamp > std::max(empty_limit, release_before))
+			break;
+		heads.pop();
+
+		auto& s = *_sources[i];
+		out.push_back(s.pending.front());
+		s.pending.pop_front();
+		_last_out = stamp;
+		_popped = true;
+		++n;
+
+		if (s.pending.empty())
+			empty_limit = std::min(empty_limit, s.newest);
+		else
+			heads.emplace(s.pending.front().first, i);
+	}
+	_stats.frames_out += n;
+	return n;
+}
+
+size_t frame_merger::pop(std::vector<timed_frame>& out, can_time now) {
+	take_inboxes();
+	auto latest = std::max(_newest, now);
+	return merge(out, latest - _opts.max_delay, false);
+}
+
+size_t frame_merger::flush(std::vector<timed_frame>& out) {
+	take_inboxes();
+	return merge(out, can_time::max(), true);
+}
+
+} // end namespace can
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <span>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "can/frame_packet.h"
+
+/*
+
+Merges the frames of several sources, e.g. CAN interfaces read on separate
+threads, into one stream in timestamp order, as v2c_transcoder expects them.
+
+Every source pushes its frames from its own thread, mostly in timestamp order.
+The consumer thread pops the merged frames with a k-way merge: a heap of the
+oldest pending frame of every source. A frame is popped once no source can
+still push an older one. That is the case when every other source either has a
+pending frame or has pushed a frame at least as new already. The case of idle
+sources is covered by `max_delay`: a frame is popped anyway once it is older than
+the newest frame pushed, or than the time given to pop(), by `max_delay`.
+
+A frame older than the last popped one is late and dropped, so the merged stream
+never goes back in time. Late frames are counted. So are frames a source
+pushed out of order and the merger put back in order.
+
+The index of a frame's source is recorded as its bus, see can::frame_bus(), which
+is why there can be at most 256 sources. The merged frames are transcoded with
+
+	for (const auto& [stamp, frame] : merged)
+		transcoder.transcode(stamp, frame, can::frame_bus(frame));
+
+*/
+
+namespace can {
+
+struct frame_merger_options {
+	std::chrono::microseconds max_delay { 50'000 }; // the longest a frame waits for the other sources
+};
+
+struct frame_merger_stats {
+	uint64_t frames_in = 0;
+	uint64_t frames_out = 0;
+	uint64_t late = 0;      // dropped, older than a frame already popped
+	uint64_t reordered = 0; // out of order within their source
+};
+
+class frame_merger {
+	struct source {
+		std::mutex lock;
+		std::vector<timed_frame> inbox; // pushed, not yet seen by pop()
+
+		// used only by the consumer thread
+		std::deque<timed_frame> pending; // in timestamp order
+		can_time newest {};              // newest frame taken from the inbox
+		bool seen = false;
+	};
+
+	std::vector<std::unique_ptr<source>> _sources;
+	frame_merger_options _opts;
+	std::vector<timed_frame> _scratch;
+	can_time _newest {};   // newest frame pushed by any source
+	can_time _last_out {}; // last frame popped
+	bool _popped = false;
+	frame_merger_stats _stats;
+
+public:
+	explicit frame_merger(size_t sources, const frame_merger_options& opts = {});
+
+	frame_merger(const frame_merger&) = delete;
+	frame_merger& operator=(const frame_merger&) = delete;
+
+	size_t sources() const { return _sources.size(); }
+
+	// Called by the thread reading `source`.
+	void push(size_t source, can_time stamp, can_frame frame);
+	void push(size_t source, std::span<const timed_frame> frames);
+
+	// Called by the consumer thread. Appends the frames that can be merged to `out`, in
+	// timestamp order, and returns their number. `now`, if given, releases the frames older
+	// than now - max_delay even if no newer frames were pushed, e.g. when all buses are idle.
+	size_t pop(std::vector<timed_frame>& out, can_time now = {});
+
+	// Appends all the pending frames, at the end of the input.
+	size_t flush(std::vector<timed_frame>& out);
+
+	// Called by the consumer thread.
+	frame_merger_stats stats() const { return _stats; }
+
+private:
+	void take_inboxes();
+	size_t merge(std::vector<timed_frame>& out, can_time release_before, bool all);
+};
+
+} // end namespace can
@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <chrono>
+#include <cstring>
+#include <utility>
 
 #include "can/can_kernel.h"
 
@@ -12,6 +14,8 @@
 |usec part (4 byte)|CAN frame|
 ...
 
+The CAN bus a frame was received on is in the frame's __pad byte, 0 on single-bus devices.
+
 */
 
 namespace can {
@@ -25,7 +29,16 @@ inline bool use_non_muxed(can_frame& cf) {
 	return cf.__res0 & 0x1;
 }
 
+inline void frame_bus(can_frame& cf, uint8_t bus) {
+	cf.__pad = bus;
+}
+
+inline uint8_t frame_bus(const can_frame& cf) {
+	return cf.__pad;
+}
+
 using can_time = std::chrono::system_clock::time_point;
+using timed_frame = std::pair<can_time, can_frame>;
 
 class frame_packet {
 	using base = std::vector<uint8_t>;
@@ -39,9 +52,9 @@ public:
 	frame_packet(const frame_packet&) = delete;
 	frame_packet& operator=(const frame_packet&) = delete;
 
-	void prepare(uint32_t utc) {
+	void prepare(uint32_t utc, size_t reserve = 32 * 1024) {
 		_buff.resize(0);
-		_buff.reserve(32 * 1024);
+		_buff.reserve(reserve);
 
 		// DBC version
 		constexpr uint16_t dbc_version = 100;
@@ -81,23 +94,70 @@ public:
 		_buff.insert(_buff.end(), b, b + sizeof(can_frame));
 	}
 
+	// appends records serialized into another packet with the same utc
+	void append(const uint8_t* records_begin, const uint8_t* records_end) {
+		_buff.insert(_buff.end(), records_begin, records_end);
+	}
+
 	std::vector<uint8_t> release() {
 		return std::move(_buff);
 	}
 };
 
 
+// Non-owning view of a serialized frame_packet, e.g. one that lives in a
+// memory-mapped file or a network buffer. Has the same layout and read interface
+// as frame_packet, without the copy into a std::vector.
+
+class frame_packet_view {
+	const uint8_t* _begin = nullptr;
+	const uint8_t* _end = nullptr;
+public:
+	frame_packet_view() { }
+	frame_packet_view(const uint8_t* begin, const uint8_t* end) : _begin(begin), _end(end) { }
+	frame_packet_view(const frame_packet& fp) : _begin(fp.data_begin()), _end(fp.data_end()) { }
+
+	uint32_t utc() const {
+		return *(const uint32_t*)(_begin + 2);
+	}
+
+	bool empty() const {
+		return byte_size() <= 6;
+	}
+
+	size_t byte_size() const {
+		return _end - _begin;
+	}
+
+	const uint8_t* data_begin() const {
+		return _begin;
+	}
+
+	const uint8_t* data_end() const {
+		return _end;
+	}
+};
+
 class frame_iterator_sentinel{};
 
 class frame_iterator {
-	const frame_packet& _frame_packet;
+	frame_packet_view _frame_packet;
 	uint32_t _packet_utc = 0;
 	const uint8_t* _msg_iter;
 
+	static constexpr size_t record_size = 4 + sizeof(can_frame);
+
+	// a truncated record at the end isn't a frame
+	void skip_partial() {
+		if (size_t(_frame_packet.data_end() - _msg_iter) < record_size)
+			_msg_iter = _frame_packet.data_end();
+	}
+
 public:
-	frame_iterator(const frame_packet& fp) : _frame_packet(fp) {
-		_packet_utc = fp.utc();
-		_msg_iter = fp.data_begin() + 6;
+	frame_iterator(frame_packet_view fp) : _frame_packet(fp) {
+		_packet_utc = fp.byte_size() >= 6 ? fp.utc() : 0;
+		_msg_iter = fp.byte_size() >= 6 ? fp.data_begin() + 6 : fp.data_end();
+		skip_partial();
 	}
 
 	~frame_iterator() {}
@@ -109,7 +169,7 @@ public:
 		return _msg_iter == _frame_packet.data_end(); 
 	}
 
-	std::pair<can_time, can_frame> operator*() {
+	timed_frame operator*() {
 		using namespace std::chrono;
 		int32_t millis = *(const int32_t*)_msg_iter;
 		can_frame frame;
@@ -121,7 +181,8 @@ public:
 	frame_iterator& operator++() {
 		if (_frame_packet.empty())
 			return *this;
-		_msg_iter += 4 + sizeof(can_frame);
+		_msg_iter += record_size;
+		skip_partial();
 
 		return *this;
 	}
@@ -135,4 +196,12 @@ inline frame_iterator_sentinel end(const frame_packet&) {
 	return {};
 }
 
+inline frame_iterator begin(frame_packet_view fp) {
+	return frame_iterator(fp);
+}
+
+inline frame_iterator_sentinel end(frame_packet_view) {
+	return {};
+}
+
 } // end namespace can
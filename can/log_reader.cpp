@@ -0,0 +1,335 @@
+#include <array>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <boost/endian.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "log_reader.h"
+
+namespace bip = boost::interprocess;
+
+namespace can {
+
+struct hex_table {
+	std::array<uint8_t, 256> val;
+
+	constexpr hex_table() : val() {
+		for (auto& v : val) v = 0xFF;
+		for (int c = '0'; c <= '9'; ++c) val[c] = uint8_t(c - '0');
+		for (int c = 'a'; c <= 'f'; ++c) val[c] = uint8_t(c - 'a' + 10);
+		for (int c = 'A'; c <= 'F'; ++c) val[c] = uint8_t(c - 'A' + 10);
+	}
+};
+
+constexpr hex_table hex_ {};
+
+static bool is_hex(char c) {
+	return hex_.val[uint8_t(c)] != 0xFF;
+}
+
+// Decodes 16 hex digits into 8 bytes with 64-bit SWAR arithmetic. Digits map to
+// (c & 0xF) and letters of either case to (c & 0xF) + 9; bit 6 tells them apart.
+static bool hex_decode_16(const char* s, uint8_t* out) {
+	uint8_t bad = 0;
+	for (int i = 0; i < 16; ++i)
+		bad |= hex_.val[uint8_t(s[i])];
+	if (bad & 0x80)
+		return false;
+
+	for (int half = 0; half < 2; ++half) {
+		uint64_t v = boost::endian::load_little_u64((const unsigned char*)s + 8 * half);
+		v = (v & 0x0F0F0F0F0F0F0F0Full) + ((v >> 6) & 0x0101010101010101ull) * 9;
+		v = ((v << 4) | (v >> 8)) & 0x00FF00FF00FF00FFull;
+		v = (v | (v >> 8)) & 0x0000FFFF0000FFFFull;
+		v = (v | (v >> 16)) & 0x00000000FFFFFFFFull;
+		boost::endian::store_little_u32(out + 4 * half, uint32_t(v));
+	}
+	return true;
+}
+
+static bool hex_decode(const char* s, size_t nbytes, uint8_t* out) {
+	if (nbytes == 8)
+		return hex_decode_16(s, out);
+
+	for (size_t i = 0; i < nbytes; ++i) {
+		uint8_t hi = hex_.val[uint8_t(s[2 * i])], lo = hex_.val[uint8_t(s[2 * i + 1])];
+		if ((hi | lo) & 0x80)
+			return false;
+		out[i] = uint8_t(hi << 4 | lo);
+	}
+	return true;
+}
+
+// parses "hex digits" up to the first non-hex char; returns false if there were none
+static bool parse_hex_id(const char*& p, const char* e, uint32_t& id, size_t& ndigits) {
+	const char* b = p;
+	id = 0;
+	while (p != e && is_hex(*p))
+		id = (id << 4) | hex_.val[uint8_t(*p++)];
+	ndigits = p - b;
+	return ndigits != 0 && ndigits <= 8;
+}
+
+static bool parse_dec_id(const char*& p, const char* e, uint32_t& id) {
+	const char* b = p;
+	id = 0;
+	while (p != e && *p >= '0' && *p <= '9')
+		id = id * 10 + (*p++ - '0');
+	return p != b;
+}
+
+// parses "<seconds>.<fraction>" into nanoseconds
+static bool parse_stamp(const char*& p, const char* e, int64_t& nanos) {
+	int64_t secs = 0, frac = 0, scale = 1'000'000'000;
+	const char* b = p;
+	while (p != e && *p >= '0' && *p <= '9')
+		secs = secs * 10 + (*p++ - '0');
+	if (p == b)
+		return false;
+	if (p != e && *p == '.') {
+		++p;
+		while (p != e && *p >= '0' && *p <= '9') {
+			if (scale > 1) {
+				scale /= 10;
+				frac += (*p - '0') * scale;
+			}
+			++p;
+		}
+	}
+	nanos = secs * 1'000'000'000 + frac;
+	return true;
+}
+
+static const char* skip_blanks(const char* p, const char* e) {
+	while (p != e && (*p == ' ' || *p == '\t'))
+		++p;
+	return p;
+}
+
+static const char* skip_token(const char* p, const char* e) {
+	while (p != e && *p != ' ' && *p != '\t')
+		++p;
+	return p;
+}
+
+static can_time stamp_time(can_time base, int64_t nanos) {
+	using namespace std::chrono;
+	return base + duration_cast<can_time::duration>(nanoseconds(nanos));
+}
+
+// (1436509052.249713) can0 123#DEADBEEF
+static bool parse_candump_line(const char* p, const char* e, timed_frame& tf) {
+	if (p == e || *p != '(')
+		return false;
+	int64_t nanos;
+	if (!parse_stamp(++p, e, nanos) || p == e || *p != ')')
+		return false;
+
+	p = skip_blanks(p + 1, e);
+	p = skip_blanks(skip_token(p, e), e); // interface
+
+	uint32_t id;
+	size_t ndigits;
+	if (!parse_hex_id(p, e, id, ndigits) || p == e || *p != '#')
+		return false;
+	++p;
+
+	can_frame cf {};
+	if (ndigits == 8)
+		cf.can_id = (id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+	else if (ndigits == 3)
+		cf.can_id = id & CAN_SFF_MASK;
+	else
+		return false;
+
+	if (p != e && *p == 'R') {
+		cf.can_id |= CAN_RTR_FLAG;
+		if (++p != e && *p >= '0' && *p <= '8')
+			cf.len = uint8_t(*p - '0');
+	}
+	else {
+		const char* d = p;
+		while (p != e && *p != ' ' && *p != '\r')
+			++p;
+		size_t nchars = p - d;
+		// '#' here means a CAN FD frame, which doesn't fit in can_frame
+		if (nchars % 2 || nchars > 2 * CAN_MAX_DLEN || !hex_decode(d, nchars / 2, cf.data))
+			return false;
+		cf.len = uint8_t(nchars / 2);
+	}
+
+	tf = { stamp_time(can_time{}, nanos), cf };
+	return true;
+}
+
+//    0.015991 1  18FEF100x       Rx   d 8 01 02 03 04 05 06 07 08
+static bool parse_asc_line(const char* p, const char* e, can_time base, bool hex_ids, timed_frame& tf) {
+	p = skip_blanks(p, e);
+	int64_t nanos;
+	if (!parse_stamp(p, e, nanos))
+		return false;
+
+	p = skip_blanks(p, e);
+	uint32_t channel;
+	if (!parse_dec_id(p, e, channel))
+		return false; // events such as "Start of measurement" or "CANFD ..."
+
+	p = skip_blanks(p, e);
+	uint32_t id;
+	size_t ndigits;
+	if (!(hex_ids ? parse_hex_id(p, e, id, ndigits) : parse_dec_id(p, e, id)))
+		return false;
+
+	can_frame cf {};
+	cf.can_id = id & CAN_SFF_MASK;
+	if (p != e && *p == 'x') {
+		cf.can_id = (id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+		++p;
+	}
+	if (p != e && *p != ' ' && *p != '\t')
+		return false; // "ErrorFrame" and the like
+
+	p = skip_blanks(skip_token(skip_blanks(p, e), e), e); // Rx / Tx
+	if (p == e || (*p != 'd' && *p != 'r'))
+		return false;
+	bool remote = *p == 'r';
+
+	p = skip_blanks(p + 1, e);
+	if (p == e || *p < '0' || *p > '8')
+		return false;
+	cf.len = uint8_t(*p++ - '0');
+
+	if (remote)
+		cf.can_id |= CAN_RTR_FLAG;
+	else {
+		for (unsigned i = 0; i < cf.len; ++i) {
+			p = skip_blanks(p, e);
+			if (e - p < 2 || !hex_decode(p, 1, cf.data + i))
+				return false;
+			p += 2;
+		}
+	}
+
+	tf = { stamp_time(base, nanos), cf };
+	return true;
+}
+
+template <typename LineParser>
+static log_read_stats parse_chunk(std::string_view chunk, LineParser&& parse_line, std::vector<timed_frame>& out) {
+	log_read_stats stats;
+	out.clear();
+	out.reserve(chunk.size() / 32);
+
+	const char* p = chunk.data();
+	const char* end = p + chunk.size();
+	while (p != end) {
+		const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		const char* le = eol ? eol : end;
+		const char* trimmed = (le != p && le[-1] == '\r') ? le - 1 : le;
+
+		if (trimmed != p) {
+			++stats.lines;
+			timed_frame tf;
+			if (parse_line(p, trimmed, tf)) {
+				out.push_back(tf);
+				++stats.frames;
+			}
+			else ++stats.skipped;
+		}
+		p = eol ? eol + 1 : end;
+	}
+	return stats;
+}
+
+// splits `log` at line boundaries into chunks of about chunk_size bytes
+static std::vector<std::string_view> split_lines(std::string_view log, size_t chunk_size) {
+	std::vector<std::string_view> chunks;
+	while (!log.empty()) {
+		size_t n = std::min(chunk_size, log.size());
+		if (n < log.size()) {
+			auto eol = log.find('\n', n);
+			n = eol == std::string_view::npos ? log.size() : eol + 1;
+		}
+		chunks.push_back(log.substr(0, n));
+		log.remove_prefix(n);
+	}
+	return chunks;
+}
+
+template <typename LineParser>
+static log_read_stats read_log(
+	std::string_view log, LineParser parse_line, frame_batch_sink& sink, const log_reader_options& opts
+) {
+	log_read_stats stats;
+	auto chunks = split_lines(log, std::max<size_t>(opts.chunk_size, 4096));
+	unsigned nthreads = std::max(1u, opts.threads);
+
+	// one round parses up to nthreads chunks in parallel, then hands them to the sink in order
+	std::vector<std::vector<timed_frame>> frames(nthreads);
+	std::vector<log_read_stats> round_stats(nthreads);
+
+	for (size_t first = 0; first < chunks.size(); first += nthreads) {
+		size_t n = std::min<size_t>(nthreads, chunks.size() - first);
+
+		auto work = [&](size_t i) {
+			round_stats[i] = parse_chunk(chunks[first + i], parse_line, frames[i]);
+		};
+
+		std::vector<std::jthread> workers;
+		for (size_t i = 1; i < n; ++i)
+			workers.emplace_back(work, i);
+		work(0);
+		workers.clear();
+
+		for (size_t i = 0; i < n; ++i) {
+			stats.lines += round_stats[i].lines;
+			stats.frames += round_stats[i].frames;
+			stats.skipped += round_stats[i].skipped;
+			if (!frames[i].empty())
+				sink(std::span<const timed_frame>(frames[i]));
+		}
+	}
+	return stats;
+}
+
+template <typename Reader>
+static log_read_stats read_mapped(const std::filesystem::path& path, Reader&& reader) {
+	if (std::filesystem::file_size(path) == 0)
+		return {};
+	bip::file_mapping file(path.c_str(), bip::read_only);
+	bip::mapped_region region(file, bip::read_only);
+	region.advise(bip::mapped_region::advice_sequential);
+	return reader(std::string_view(static_cast<const char*>(region.get_address()), region.get_size()));
+}
+
+log_read_stats read_candump(std::string_view log, frame_batch_sink sink, const log_reader_options& opts) {
+	auto parse_line = [](const char* b, const char* e, timed_frame& tf) {
+		return parse_candump_line(b, e, tf);
+	};
+	return read_log(log, parse_line, sink, opts);
+}
+
+log_read_stats read_candump(const std::filesystem::path& path, frame_batch_sink sink, const log_reader_options& opts) {
+	return read_mapped(path, [&](std::string_view log) { return read_candump(log, std::move(sink), opts); });
+}
+
+log_read_stats read_asc(std::string_view log, frame_batch_sink sink, const log_reader_options& opts) {
+	// "base hex|dec" in the header decides how IDs are written
+	auto header = log.substr(0, std::min<size_t>(log.size(), 4096));
+	bool hex_ids = header.find("base dec") == std::string_view::npos;
+
+	can_time base = opts.asc_start;
+	auto parse_line = [base, hex_ids](const char* b, const char* e, timed_frame& tf) {
+		return parse_asc_line(b, e, base, hex_ids, tf);
+	};
+	return read_log(log, parse_line, sink, opts);
+}
+
+log_read_stats read_asc(const std::filesystem::path& path, frame_batch_sink sink, const log_reader_options& opts) {
+	return read_mapped(path, [&](std::string_view log) { return read_asc(log, std::move(sink), opts); });
+}
+
+} // end namespace can
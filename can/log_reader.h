@@ -0,0 +1,53 @@
+#pragma once
+
+#include <span>
+#include <algorithm>
+#include <thread>
+#include <filesystem>
+#include <string_view>
+
+#include "any/any.h"
+#include "can/frame_packet.h"
+
+/*
+
+Readers for recorded CAN traces:
+
+candump -L:
+	(1436509052.249713) can0 123#DEADBEEF
+	(1436509052.250021) can0 1F334455#R
+
+Vector ASC (absolute timestamps, relative to the measurement start):
+	   0.015991 1  123             Rx   d 8 01 02 03 04 05 06 07 08
+	   0.016034 1  18FEF100x       Rx   d 3 01 02 03
+
+The input is memory-mapped and split at line boundaries into chunks that are
+parsed on `threads` threads. Frames are handed to the sink in file order, in
+batches of one chunk each. Lines that are not classic CAN frames (CAN FD frames,
+error frames, ASC events and headers) are counted as skipped.
+
+*/
+
+namespace can {
+
+using frame_batch_sink = mireo::any_function<void(std::span<const timed_frame>)>;
+
+struct log_reader_options {
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t chunk_size = 4 * 1024 * 1024;
+	can_time asc_start {}; // ASC timestamps are offsets from this time point
+};
+
+struct log_read_stats {
+	uint64_t lines = 0;
+	uint64_t frames = 0;
+	uint64_t skipped = 0;
+};
+
+log_read_stats read_candump(std::string_view log, frame_batch_sink sink, const log_reader_options& opts = {});
+log_read_stats read_candump(const std::filesystem::path& path, frame_batch_sink sink, const log_reader_options& opts = {});
+
+log_read_stats read_asc(std::string_view log, frame_batch_sink sink, const log_reader_options& opts = {});
+log_read_stats read_asc(const std::filesystem::path& path, frame_batch_sink sink, const log_reader_options& opts = {});
+
+} // end namespace can
@@ -0,0 +1,329 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include <boost/crc.hpp>
+
+#include "packet_store.h"
+
+namespace bip = boost::interprocess;
+
+namespace can {
+
+constexpr char segment_magic[8] = { 'V', '2', 'C', 'S', 'E', 'G', '\0', '\0' };
+constexpr uint32_t segment_version = 1;
+
+static size_t padded(size_t n) {
+	return (n + 7) & ~size_t(7);
+}
+
+static uint32_t record_crc(uint64_t seq, const uint8_t* payload, size_t size) {
+	boost::crc_32_type crc;
+	crc.process_bytes(&seq, sizeof(seq));
+	crc.process_bytes(payload, size);
+	return crc.checksum();
+}
+
+static std::filesystem::path segment_path(const std::filesystem::path& dir, uint64_t base_seq) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.seg", (unsigned long long)base_seq);
+	return dir / name;
+}
+
+static std::filesystem::filesystem_error fs_error(const char* what, const std::filesystem::path& path, int err) {
+	return { what, path, std::error_code(err, std::generic_category()) };
+}
+
+// Makes the directory entries created or removed in `dir` durable. Windows has no
+// equivalent, NTFS journals directory changes itself.
+static void sync_dir(const std::filesystem::path& dir) {
+#ifndef _WIN32
+	int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		throw fs_error("packet_store: can't open directory", dir, errno);
+	int rv = ::fsync(fd);
+	int err = errno;
+	::close(fd);
+	if (rv != 0)
+		throw fs_error("packet_store: can't sync directory", dir, err);
+#endif // _WIN32
+}
+
+// Creates a segment file with all of its blocks allocated, so writes through the
+// mapping can't fail for lack of space, and makes the file and its size durable.
+static void create_segment_file(const std::filesystem::path& path, size_t size) {
+#ifndef _WIN32
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		throw fs_error("packet_store: can't create segment", path, errno);
+	int err = ::posix_fallocate(fd, 0, off_t(size));
+	if (err == 0 && ::fsync(fd) != 0)
+		err = errno;
+	::close(fd);
+	if (err != 0) {
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+		throw fs_error("packet_store: can't allocate segment", path, err);
+	}
+#else // _WIN32
+	{
+		std::ofstream create(path, std::ios::binary | std::ios::trunc);
+	}
+	std::filesystem::resize_file(path, size);
+#endif // _WIN32
+	sync_dir(path.parent_path());
+}
+
+packet_store::packet_store(std::filesystem::path dir, packet_store_options opts) :
+	_dir(std::move(dir)), _opts(opts)
+{
+	_opts.segment_size = padded(std::max(_opts.segment_size, segment_header_size + record_header_size + 64));
+	_opts.max_segments = std::max<size_t>(_opts.max_segments, 1);
+
+	std::filesystem::create_directories(_dir);
+	recover();
+}
+
+packet_store::~packet_store() {
+	sync();
+}
+
+size_t packet_store::max_payload() const {
+	// leaves room for the zero terminator after the record
+	return _opts.segment_size - segment_header_size - record_header_size - 8;
+}
+
+void packet_store::map_segment(segment& seg) {
+	if (seg.region)
+		return;
+	bip::file_mapping file(seg.path.c_str(), bip::read_write);
+	seg.region = std::make_unique<bip::mapped_region>(file, bip::read_write);
+}
+
+void packet_store::recover() {
+	std::vector<std::filesystem::path> paths;
+	for (const auto& entry : std::filesystem::directory_iterator(_dir))
+		if (entry.is_regular_file() && entry.path().extension() == ".seg")
+			paths.push_back(entry.path());
+
+	// names are fixed-width hex base seqs, so lexical order is seq order
+	std::sort(paths.begin(), paths.end());
+
+	for (auto& path : paths) {
+		segment seg;
+		seg.path = path;
+
+		if (!recover_segment(seg)) {
+			fprintf(stderr, "packet_store: dropping unreadable segment %s\n", path.string().c_str());
+			remove_segment(seg);
+			continue;
+		}
+
+		_stats.recovered_packets += seg.packets;
+		_next_seq = std::max(_next_seq, seg.next_seq);
+		_segments.push_back(std::move(seg));
+	}
+
+	// only the last segment is appended to, older ones can be unmapped until read
+	for (size_t i = 1; i + 1 < _segments.size(); ++i)
+		_segments[i].region.reset();
+}
+
+bool packet_store::recover_segment(segment& seg) {
+	if (std::filesystem::file_size(seg.path) != _opts.segment_size)
+		return false;
+
+	map_segment(seg);
+	const uint8_t* d = seg.data();
+
+	if (std::memcmp(d, segment_magic, sizeof(segment_magic)) != 0)
+		return false;
+	if (*(const uint32_t*)(d + 8) != segment_version)
+		return false;
+
+	seg.base_seq = *(const uint64_t*)(d + 16);
+	seg.next_seq = seg.base_seq;
+
+	size_t pos = segment_header_size;
+	while (auto sp = record_at(seg, pos)) {
+		if (sp->seq != seg.next_seq)
+			break;
+		pos += record_header_size + padded(sp->packet.byte_size());
+		seg.next_seq = sp->seq + 1;
+		++seg.packets;
+	}
+
+	// anything after the last good record is a torn write; it is overwritten by
+	// the next append, and the zero terminator written then hides its remains
+	uint32_t tail_size = pos + 4 <= _opts.segment_size ? *(const uint32_t*)(d + pos) : 0;
+	if (tail_size != 0)
+		_stats.dropped_bytes += std::min<size_t>(record_header_size + padded(tail_size), _opts.segment_size - pos);
+
+	seg.write_pos = seg.synced_pos = pos;
+	seg.read_pos = segment_header_size;
+	return true;
+}
+
+std::optional<stored_packet> packet_store::record_at(const segment& seg, size_t pos) const {
+	if (pos + record_header_size > _opts.segment_size)
+		return std::nullopt;
+
+	const uint8_t* rec = seg.data() + pos;
+	uint32_t size = *(const uint32_t*)rec;
+	uint32_t crc = *(const uint32_t*)(rec + 4);
+	uint64_t seq = *(const uint64_t*)(rec + 8);
+
+	if (size == 0 || size > _opts.segment_size - pos - record_header_size)
+		return std::nullopt;
+
+	const uint8_t* payload = rec + record_header_size;
+	if (record_crc(seq, payload, size) != crc)
+		return std::nullopt;
+
+	return stored_packet{ seq, frame_packet_view(payload, payload + size) };
+}
+
+void packet_store::roll_segment() {
+	if (!_segments.empty())
+		sync_segment(_segments.back());
+
+	while (_segments.size() >= _opts.max_segments)
+		evict_front();
+
+	segment seg;
+	seg.base_seq = seg.next_seq = _next_seq;
+	seg.path = segment_path(_dir, seg.base_seq);
+
+	create_segment_file(seg.path, _opts.segment_size);
+	map_segment(seg);
+
+	uint8_t* d = seg.data();
+	std::memcpy(d, segment_magic, sizeof(segment_magic));
+	*(uint32_t*)(d + 8) = segment_version;
+	*(uint32_t*)(d + 12) = 0;
+	*(uint64_t*)(d + 16) = seg.base_seq;
+
+	seg.write_pos = seg.read_pos = segment_header_size;
+	seg.synced_pos = 0; // header is flushed with the first batch
+
+	// the previous segment won't be written to again; keep it mapped only if it is being read
+	if (_segments.size() > 1)
+		_segments.back().region.reset();
+
+	_segments.push_back(std::move(seg));
+}
+
+void packet_store::evict_front() {
+	auto& seg = _segments.front();
+	_stats.evicted_packets += seg.packets - seg.read_packets;
+	remove_segment(seg);
+	_segments.pop_front();
+}
+
+void packet_store::remove_segment(segment& seg) {
+	seg.region.reset();
+	std::filesystem::remove(seg.path);
+	sync_dir(_dir);
+}
+
+bool packet_store::append(frame_packet_view fp) {
+	size_t size = fp.byte_size();
+	if (size == 0 || size > max_payload())
+		return false;
+
+	size_t rec_size = record_header_size + padded(size);
+	if (_segments.empty() || _segments.back().write_pos + rec_size + 8 > _opts.segment_size)
+		roll_segment();
+
+	auto& seg = _segments.back();
+	map_segment(seg);
+
+	uint64_t seq = _next_seq++;
+	uint8_t* rec = seg.data() + seg.write_pos;
+
+	std::memcpy(rec + record_header_size, fp.data_begin(), size);
+	std::memset(rec + record_header_size + size, 0, padded(size) - size);
+	*(uint64_t*)(rec + 8) = seq;
+	*(uint32_t*)(rec + 4) = record_crc(seq, fp.data_begin(), size);
+	*(uint32_t*)rec = uint32_t(size);
+	*(uint32_t*)(rec + rec_size) = 0;
+
+	seg.write_pos += rec_size;
+	seg.next_seq = _next_seq;
+	++seg.packets;
+
+	if (_opts.sync_every && ++_unsynced >= _opts.sync_every)
+		sync();
+
+	return true;
+}
+
+void packet_store::sync_segment(segment& seg) {
+	if (!seg.region || seg.synced_pos == seg.write_pos)
+		return;
+
+	// + 8 covers the zero terminator that follows the last record
+	size_t end = std::min(seg.write_pos + 8, _opts.segment_size);
+	seg.region->flush(seg.synced_pos, end - seg.synced_pos, false);
+	seg.synced_pos = seg.write_pos;
+	++_stats.syncs;
+}
+
+void packet_store::sync() {
+	if (!_segments.empty())
+		sync_segment(_segments.back());
+	_unsynced = 0;
+}
+
+std::optional<stored_packet> packet_store::front() {
+	while (!_segments.empty()) {
+		auto& seg = _segments.front();
+		if (seg.read_pos < seg.write_pos) {
+			map_segment(seg);
+			return record_at(seg, seg.read_pos);
+		}
+		if (_segments.size() == 1)
+			break;
+		// fully consumed and no longer written to
+		remove_segment(seg);
+		_segments.pop_front();
+	}
+	return std::nullopt;
+}
+
+void packet_store::pop_front() {
+	auto sp = front();
+	if (!sp)
+		return;
+
+	auto& seg = _segments.front();
+	seg.read_pos += record_header_size + padded(sp->packet.byte_size());
+	++seg.read_packets;
+
+	if (seg.read_pos == seg.write_pos && _segments.size() > 1) {
+		remove_segment(seg);
+		_segments.pop_front();
+	}
+}
+
+size_t packet_store::size() const {
+	size_t n = 0;
+	for (const auto& seg : _segments)
+		n += seg.packets - seg.read_packets;
+	return n;
+}
+
+packet_store_stats packet_store::stats() const {
+	auto rv = _stats;
+	rv.packets = size();
+	rv.segments = _segments.size();
+	return rv;
+}
+
+} // end namespace can
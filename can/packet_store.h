@@ -0,0 +1,144 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <filesystem>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "can/frame_packet.h"
+
+/*
+
+Persistent store-and-forward queue of frame_packets.
+
+The store is a directory of fixed-size, memory-mapped segment files. Packets are
+appended to the newest segment and read (zero-copy) from the oldest one:
+
+|segment magic (8 byte)|format version (4 byte)|reserved (4 byte)|base seq (8 byte)|
+|payload size (4 byte)|CRC-32 of seq + payload (4 byte)|seq (8 byte)|payload|pad to 8|
+|payload size (4 byte)|CRC-32 of seq + payload (4 byte)|seq (8 byte)|payload|pad to 8|
+...
+|0 (4 byte)|
+
+Segments are preallocated and only ever written sequentially, so a flash device
+sees one pass over each segment. A new segment's blocks are allocated, and the file
+and its directory entry synced, before it's mapped, so writes through the mapping
+can't run out of space and a synced record isn't lost with its segment. Dirty pages are flushed every `sync_every`
+packets (or on sync()), not on every append.
+
+On open, every segment is scanned and the first record with a bad size or CRC
+ends it, so packets torn by a power loss are dropped. When the store holds
+`max_segments` segments, the oldest segment is evicted to make room.
+
+Delivery is at-least-once: pop_front() does not write to flash, so after a crash
+the packets of a partially consumed segment are read again. Use seq to dedupe.
+
+*/
+
+namespace can {
+
+struct packet_store_options {
+	size_t segment_size = 4 * 1024 * 1024;
+	size_t max_segments = 64;
+	size_t sync_every = 16; // 0 disables automatic syncing
+};
+
+struct packet_store_stats {
+	size_t packets = 0;
+	size_t segments = 0;
+	uint64_t evicted_packets = 0;
+	uint64_t recovered_packets = 0;
+	uint64_t dropped_bytes = 0; // torn or corrupt tails found on open
+	uint64_t syncs = 0;
+};
+
+struct stored_packet {
+	uint64_t seq;
+	frame_packet_view packet;
+};
+
+class packet_store {
+	static constexpr size_t segment_header_size = 24;
+	static constexpr size_t record_header_size = 16;
+
+	struct segment {
+		std::filesystem::path path;
+		uint64_t base_seq = 0;
+		uint64_t next_seq = 0;
+		size_t write_pos = 0;
+		size_t read_pos = 0;
+		size_t synced_pos = 0;
+		size_t packets = 0;
+		size_t read_packets = 0;
+
+		std::unique_ptr<boost::interprocess::mapped_region> region;
+
+		uint8_t* data() const { return static_cast<uint8_t*>(region->get_address()); }
+	};
+
+	std::filesystem::path _dir;
+	packet_store_options _opts;
+	std::deque<segment> _segments;
+	uint64_t _next_seq = 1;
+	size_t _unsynced = 0;
+	packet_store_stats _stats;
+
+public:
+	explicit packet_store(std::filesystem::path dir, packet_store_options opts = {});
+	~packet_store();
+
+	packet_store(const packet_store&) = delete;
+	packet_store& operator=(const packet_store&) = delete;
+
+	bool append(frame_packet_view fp);
+	void sync();
+
+	// The packet points into the mapped front segment, and is valid only until the next
+	// pop_front(), which unmaps the segment once it is consumed, or append(), which may
+	// evict it. Copy it into a frame_packet to keep it longer.
+	std::optional<stored_packet> front();
+	void pop_front();
+
+	// Calls f(seq, packet) for every packet, oldest first. The packet is valid only during the call.
+	template <typename F>
+	void for_each(F&& f);
+
+	bool empty() const { return size() == 0; }
+	size_t size() const;
+	uint64_t last_seq() const { return _next_seq - 1; }
+	packet_store_stats stats() const;
+
+private:
+	void recover();
+	bool recover_segment(segment& seg);
+	void roll_segment();
+	void evict_front();
+	void remove_segment(segment& seg);
+	void map_segment(segment& seg);
+	void sync_segment(segment& seg);
+	size_t max_payload() const;
+	std::optional<stored_packet> record_at(const segment& seg, size_t pos) const;
+};
+
+template <typename F>
+void packet_store::for_each(F&& f) {
+	for (size_t i = 0; i < _segments.size(); ++i) {
+		auto& seg = _segments[i];
+		map_segment(seg);
+		for (size_t pos = seg.read_pos; pos < seg.write_pos; ) {
+			auto sp = record_at(seg, pos);
+			if (!sp)
+				break;
+			f(sp->seq, sp->packet);
+			pos += record_header_size + ((sp->packet.byte_size() + 7) & ~size_t(7));
+		}
+		// only the front segment is read and the back one written, the others are mapped while visited
+		if (i != 0 && i + 1 != _segments.size())
+			seg.region.reset();
+	}
+}
+
+} // end namespace can
@@ -0,0 +1,340 @@
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include <boost/crc.hpp>
+
+#include "dbc_cache.h"
+#include "dbc_grammar.h"
+
+namespace bip = boost::interprocess;
+
+namespace can {
+
+constexpr char cache_magic[8] = { 'V', '2', 'C', 'D', 'B', 'C', '\0', '\0' };
+
+namespace {
+
+class record_reader {
+	const char* _pos;
+	const char* _end;
+public:
+	explicit record_reader(std::string_view records) :
+		_pos(records.data()), _end(records.data() + records.size())
+	{}
+
+	bool at_end() const { return _pos == _end; }
+
+	bool byte(uint8_t& v) {
+		if (_pos == _end)
+			return false;
+		v = uint8_t(*_pos++);
+		return true;
+	}
+
+	bool varint(uint64_t& v) {
+		v = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			uint8_t b;
+			if (!byte(b))
+				return false;
+			v |= uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	bool length(size_t& n) {
+		uint64_t v;
+		if (!varint(v) || v > size_t(_end - _pos))
+			return false;
+		n = size_t(v);
+		return true;
+	}
+
+	bool get(char& v) {
+		uint8_t b;
+		return byte(b) && (v = char(b), true);
+	}
+
+	template <std::unsigned_integral T>
+	bool get(T& v) {
+		uint64_t u;
+		return varint(u) && (v = T(u), true);
+	}
+
+	template <std::signed_integral T>
+	bool get(T& v) {
+		uint64_t u;
+		return varint(u) && (v = T(int64_t(u >> 1) ^ -int64_t(u & 1)), true);
+	}
+
+	bool get(double& v) {
+		if (_end - _pos < 8)
+			return false;
+		uint64_t bits = 0;
+		for (int i = 0; i < 8; ++i)
+			bits |= uint64_t(uint8_t(_pos[i])) << (8 * i);
+		_pos += 8;
+		v = std::bit_cast<double>(bits);
+		return true;
+	}
+
+	bool get(std::string_view& v) {
+		size_t n;
+		if (!length(n))
+			return false;
+		v = std::string_view(_pos, n);
+		_pos += n;
+		return true;
+	}
+
+	template <typename T>
+	bool get(std::optional<T>& v) {
+		uint8_t has_value;
+		if (!byte(has_value))
+			return false;
+		if (!has_value)
+			return v.reset(), true;
+		return get(v.emplace());
+	}
+
+	template <typename A, typename B>
+	bool get(std::pair<A, B>& v) {
+		return get(v.first) && get(v.second);
+	}
+
+	// spans are read into `storage`, which keeps its capacity from record to record
+	template <typename T>
+	bool get(std::span<const T>& v, std::vector<T>& storage) {
+		size_t n;
+		if (!length(n)) // every element takes at least one byte
+			return false;
+		storage.resize(n);
+		for (auto& e : storage)
+			if (!get(e))
+				return false;
+		v = storage;
+		return true;
+	}
+
+	template <typename ...Ts>
+	bool get(std::variant<Ts...>& v) {
+		uint8_t index;
+		if (!byte(index) || index >= sizeof...(Ts))
+			return false;
+		return get_alternative(v, index, std::index_sequence_for<Ts...>{});
+	}
+
+private:
+	template <typename V, size_t ...Is>
+	bool get_alternative(V& v, uint8_t index, std::index_sequence<Is...>) {
+		bool rv = false;
+		((Is == index ? (rv = get(v.template emplace<Is>()), true) : false) || ...);
+		return rv;
+	}
+};
+
+template <typename T>
+struct arg_storage {
+	using type = std::monostate;
+};
+
+template <typename T>
+struct arg_storage<std::span<const T>> {
+	using type = std::vector<T>;
+};
+
+template <typename T>
+bool get_arg(record_reader& rr, T& arg, std::monostate&) {
+	return rr.get(arg);
+}
+
+template <typename T>
+bool get_arg(record_reader& rr, std::span<const T>& arg, std::vector<T>& storage) {
+	return rr.get(arg, storage);
+}
+
+template <typename Cpo>
+struct replay_callback;
+
+template <auto method, typename OwningCpo, typename ...Args>
+struct replay_callback<view_cpo<method, OwningCpo, Args...>> {
+	using storage_type = std::tuple<typename arg_storage<Args>::type...>;
+
+	static bool replay(record_reader& rr, interpreter& ipt, storage_type& storage) {
+		std::tuple<Args...> args;
+		bool read = [&]<size_t ...Is>(std::index_sequence<Is...>) {
+			return (get_arg(rr, std::get<Is>(args), std::get<Is>(storage)) && ...);
+		}(std::index_sequence_for<Args...>{});
+		if (!read)
+			return false;
+		std::apply([&](auto& ...a) { view_cpo<method, OwningCpo, Args...>{}(ipt, a...); }, args);
+		return true;
+	}
+};
+
+template <typename Tuple>
+struct replayer;
+
+template <typename ...Cpos>
+struct replayer<std::tuple<Cpos...>> {
+	std::tuple<typename replay_callback<Cpos>::storage_type...> storage;
+
+	bool replay(uint8_t tag, record_reader& rr, interpreter& ipt) {
+		return [&]<size_t ...Is>(std::index_sequence<Is...>) {
+			bool rv = false;
+			((Is == tag ? (rv = replay_callback<Cpos>::replay(rr, ipt, std::get<Is>(storage)), true) : false) || ...);
+			return rv;
+		}(std::index_sequence_for<Cpos...>{});
+	}
+};
+
+template <typename T>
+void put_fixed(std::string& out, T v) {
+	for (size_t i = 0; i < sizeof(T); ++i, v >>= 8)
+		out.push_back(char(v & 0xff));
+}
+
+template <typename T>
+T get_fixed(const char* p) {
+	T v = 0;
+	for (size_t i = 0; i < sizeof(T); ++i)
+		v |= T(uint8_t(p[i])) << (8 * i);
+	return v;
+}
+
+uint32_t records_crc(std::string_view records) {
+	boost::crc_32_type crc;
+	crc.process_bytes(records.data(), records.size());
+	return crc.checksum();
+}
+
+} // end anonymous namespace
+
+bool replay_dbc_records(std::string_view records, interpreter ipt) {
+	record_reader rr(records);
+	replayer<dbc_callbacks> rp;
+	while (!rr.at_end()) {
+		uint8_t tag;
+		if (!rr.byte(tag) || !rp.replay(tag, rr, ipt))
+			return false;
+	}
+	return true;
+}
+
+uint64_t dbc_source_hash(std::string_view dbc_src) {
+	uint64_t h = 0xcbf29ce484222325;
+	for (char c : dbc_src)
+		h = (h ^ uint8_t(c)) * 0x100000001b3;
+	return h;
+}
+
+// Makes the file, or the entries of the directory, durable. Not done on Windows, where NTFS
+// journals directory changes itself; a cache torn there fails its CRC check instead.
+static bool sync_path(const std::filesystem::path& path, bool dir) {
+#ifndef _WIN32
+	int fd = ::open(path.c_str(), dir ? O_RDONLY | O_DIRECTORY : O_RDONLY);
+	if (fd < 0)
+		return false;
+	bool synced = ::fsync(fd) == 0;
+	::close(fd);
+	return synced;
+#else // _WIN32
+	return true;
+#endif // _WIN32
+}
+
+bool write_dbc_cache(const std::filesystem::path& path, const dbc_recorder& rec, uint64_t source_hash) {
+	std::string header(cache_magic, sizeof(cache_magic));
+	put_fixed(header, dbc_cache::format_version);
+	put_fixed(header, rec.size());
+	put_fixed(header, source_hash);
+	put_fixed(header, uint64_t(rec.records().size()));
+	put_fixed(header, records_crc(rec.records()));
+	put_fixed(header, uint32_t(0));
+
+	// written aside, synced and renamed, so a power loss never leaves a half-written cache behind
+	auto tmp_path = path;
+	tmp_path += ".tmp";
+	{
+		std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+		out.write(header.data(), header.size());
+		out.write(rec.records().data(), rec.records().size());
+		if (!out.flush())
+			return false;
+	}
+	if (!sync_path(tmp_path, false))
+		return false;
+
+	std::error_code ec;
+	std::filesystem::rename(tmp_path, path, ec);
+	if (ec)
+		return false;
+	auto dir = path.parent_path();
+	return sync_path(dir.empty() ? "." : dir, true);
+}
+
+bool compile_dbc(std::string_view dbc_src, const std::filesystem::path& cache_path) {
+	dbc_recorder rec;
+	return parse_dbc(dbc_src, rec) && write_dbc_cache(cache_path, rec, dbc_source_hash(dbc_src));
+}
+
+dbc_cache::dbc_cache(const std::filesystem::path& path) {
+	std::error_code ec;
+	auto file_size = std::filesystem::file_size(path, ec);
+	if (ec || file_size < header_size)
+		return;
+
+	// the file may be unreadable, or replaced since its size was read
+	std::unique_ptr<bip::mapped_region> region;
+	try {
+		region = std::make_unique<bip::mapped_region>(
+			bip::file_mapping(path.c_str(), bip::read_only), bip::read_only
+		);
+	}
+	catch (const bip::interprocess_exception&) {
+		return;
+	}
+	if (region->get_size() < header_size)
+		return;
+
+	const char* p = static_cast<const char*>(region->get_address());
+	if (std::memcmp(p, cache_magic, sizeof(cache_magic)) || get_fixed<uint32_t>(p + 8) != format_version)
+		return;
+
+	uint64_t records_size = get_fixed<uint64_t>(p + 24);
+	if (records_size != region->get_size() - header_size)
+		return;
+
+	std::string_view records(p + header_size, records_size);
+	if (records_crc(records) != get_fixed<uint32_t>(p + 32))
+		return;
+
+	_count = get_fixed<uint32_t>(p + 12);
+	_source_hash = get_fixed<uint64_t>(p + 16);
+	_records = records;
+	_region = std::move(region);
+}
+
+bool dbc_cache::feed(interpreter ipt) const {
+	return valid() && replay_dbc_records(_records, std::move(ipt));
+}
+
+bool parse_dbc_cached(std::string_view dbc_src, const std::filesystem::path& cache_path, interpreter ipt) {
+	uint64_t source_hash = dbc_source_hash(dbc_src);
+	if (dbc_cache cache(cache_path); cache.valid() && cache.source_hash() == source_hash)
+		return cache.feed(std::move(ipt));
+
+	dbc_recorder rec;
+	if (!parse_dbc(dbc_src, rec))
+		return false;
+	write_dbc_cache(cache_path, rec, source_hash);
+	return replay_dbc_records(rec.records(), std::move(ipt));
+}
+
+} // end namespace can
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <bit>
+#include <tuple>
+#include <concepts>
+#include <memory>
+#include <cstring>
+#include <filesystem>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "dbc/dbc_parser.h"
+
+/*
+
+Precompiled binary DBC cache.
+
+A cache file holds the sequence of callbacks parse_dbc() made while parsing a
+DBC, with all of their arguments. Feeding the cache to an interpreter makes the
+very same calls, in the same order, without running the parser:
+
+|magic "V2CDBC" (8 byte)|format version (4 byte)|record count (4 byte)|
+|FNV-1a hash of the DBC source (8 byte)|records size (8 byte)|CRC-32 of records (4 byte)|reserved (4 byte)|
+|callback tag (1 byte)|arguments|
+|callback tag (1 byte)|arguments|
+...
+
+Arguments are stored in declaration order, unaligned: integers as LEB128
+varints (signed ones zigzag-encoded), chars as one byte, doubles as their
+little-endian IEEE-754 bits, strings and vectors as a varint length followed by
+the elements, optionals and variants as a 1 byte flag/index followed by the
+value. Integer widths do not matter, so the cache is the same on every platform.
+
+The file is memory-mapped read-only and can be built on another machine.
+
+*/
+
+namespace can {
+
+// Callbacks in the order of their record tags. Append only, the tag of a callback is part of the format.
+using dbc_callbacks = std::tuple<
+	def_version_view_cpo,
+	def_bu_view_cpo,
+	def_bo_view_cpo,
+	def_sg_view_cpo,
+	def_sg_mux_view_cpo,
+	def_ev_view_cpo,
+	def_envvar_data_view_cpo,
+	def_sgtype_view_cpo,
+	def_sgtype_ref_view_cpo,
+	def_sig_group_view_cpo,
+	def_cm_glob_view_cpo,
+	def_cm_bu_view_cpo,
+	def_cm_bo_view_cpo,
+	def_cm_sg_view_cpo,
+	def_cm_ev_view_cpo,
+	def_ba_def_enum_view_cpo,
+	def_ba_def_int_view_cpo,
+	def_ba_def_float_view_cpo,
+	def_ba_def_string_view_cpo,
+	def_ba_def_def_view_cpo,
+	def_ba_view_cpo,
+	def_val_env_view_cpo,
+	def_val_sg_view_cpo,
+	def_val_table_view_cpo,
+	def_sig_valtype_view_cpo,
+	def_bo_tx_bu_view_cpo,
+	def_sg_mul_val_view_cpo,
+	def_counts_view_cpo
+>;
+
+namespace detail {
+
+template <typename Cpo, typename Tuple>
+struct callback_tag;
+
+template <typename Cpo, typename ...Cpos>
+struct callback_tag<Cpo, std::tuple<Cpos...>> {
+	static constexpr uint8_t value = [] {
+		uint8_t i = 0;
+		((std::is_same_v<Cpo, Cpos> ? false : (++i, true)) && ...);
+		return i;
+	}();
+};
+
+inline void put_varint(std::string& out, uint64_t v) {
+	for (; v >= 0x80; v >>= 7)
+		out.push_back(char(v | 0x80));
+	out.push_back(char(v));
+}
+
+inline void put(std::string& out, char v) { out.push_back(v); }
+
+template <std::unsigned_integral T>
+void put(std::string& out, T v) { put_varint(out, v); }
+
+template <std::signed_integral T>
+void put(std::string& out, T v) { put_varint(out, (uint64_t(v) << 1) ^ uint64_t(int64_t(v) >> 63)); }
+
+inline void put(std::string& out, double v) {
+	uint64_t bits = std::bit_cast<uint64_t>(v);
+	for (int i = 0; i < 8; ++i, bits >>= 8)
+		out.push_back(char(bits & 0xff));
+}
+
+inline void put(std::string& out, std::string_view v) {
+	put_varint(out, v.size());
+	out.append(v);
+}
+
+template <typename T>
+void put(std::string& out, const std::optional<T>& v) {
+	out.push_back(char(v.has_value()));
+	if (v)
+		put(out, *v);
+}
+
+template <typename A, typename B>
+void put(std::string& out, const std::pair<A, B>& v) {
+	put(out, v.first);
+	put(out, v.second);
+}
+
+template <typename T>
+void put(std::string& out, std::span<const T> v) {
+	put_varint(out, v.size());
+	for (const auto& e : v)
+		put(out, e);
+}
+
+template <typename ...Ts>
+void put(std::string& out, const std::variant<Ts...>& v) {
+	out.push_back(char(v.index()));
+	std::visit([&](const auto& e) { put(out, e); }, v);
+}
+
+// One non-template tag_invoke per callback, found through ADL on the derived recorder,
+// so it is preferred over the generic fallback of view_cpo.
+template <typename Derived, typename Cpo>
+struct record_callback;
+
+template <typename Derived, auto method, typename OwningCpo, typename ...Args>
+struct record_callback<Derived, view_cpo<method, OwningCpo, Args...>> {
+	friend void tag_invoke(view_cpo<method, OwningCpo, Args...> c, Derived& this_, Args ...args) {
+		this_.record(c, args...);
+	}
+};
+
+template <typename Derived, typename Tuple>
+struct record_callbacks;
+
+template <typename Derived, typename ...Cpos>
+struct record_callbacks<Derived, std::tuple<Cpos...>> : record_callback<Derived, Cpos>... {};
+
+} // end namespace detail
+
+// Interpreter that serializes every callback it receives into cache records.
+class dbc_recorder : public detail::record_callbacks<dbc_recorder, dbc_callbacks> {
+	std::string _records;
+	uint32_t _count = 0;
+public:
+	template <typename Cpo, typename ...Args>
+	void record(Cpo, const Args& ...args) {
+		_records.push_back(char(detail::callback_tag<Cpo, dbc_callbacks>::value));
+		(detail::put(_records, args), ...);
+		++_count;
+	}
+
+	std::string_view records() const { return _records; }
+	uint32_t size() const { return _count; }
+
+	void clear() {
+		_records.clear();
+		_count = 0;
+	}
+};
+
+// Makes the recorded callbacks on the interpreter. Returns false on malformed records.
+bool replay_dbc_records(std::string_view records, interpreter ipt);
+
+uint64_t dbc_source_hash(std::string_view dbc_src);
+
+bool write_dbc_cache(const std::filesystem::path& path, const dbc_recorder& rec, uint64_t source_hash);
+
+// Parses the DBC and writes its cache, returns false if either fails.
+bool compile_dbc(std::string_view dbc_src, const std::filesystem::path& cache_path);
+
+class dbc_cache {
+	std::unique_ptr<boost::interprocess::mapped_region> _region;
+	std::string_view _records;
+	uint32_t _count = 0;
+	uint64_t _source_hash = 0;
+public:
+	static constexpr size_t header_size = 40;
+	static constexpr uint32_t format_version = 1;
+
+	// Maps the cache file. A missing, unreadable, truncated, corrupt or outdated file leaves the cache invalid.
+	explicit dbc_cache(const std::filesystem::path& path);
+
+	bool valid() const { return _region != nullptr; }
+	uint64_t source_hash() const { return _source_hash; }
+	uint32_t size() const { return _count; }
+
+	bool feed(interpreter ipt) const;
+};
+
+// Feeds the cache if it was built from this exact source, otherwise parses the DBC
+// and (re)writes the cache for the next start.
+bool parse_dbc_cached(std::string_view dbc_src, const std::filesystem::path& cache_path, interpreter ipt);
+
+} // end namespace can
@@ -0,0 +1,120 @@
+#include "dbc_file.h"
+#include "dbc_grammar.h"
+
+namespace can {
+
+namespace {
+
+using namespace dbc_grammar;
+
+// Reads a DBC in windows that end before a BO_, CM_, BA_, VAL_ or VAL_TABLE_ statement
+// continuing the list of the statement before it, or at the end of the stream.
+class window_reader {
+	std::istream& _in;
+	size_t _chunk_size;
+	std::string _buf;
+	size_t _window = 0;  // end of the current window in _buf
+	size_t _scanned = 0; // start of the first statement not yet scanned for a window end
+	std::string _prev;   // keyword of the statement before _scanned
+	bool _eof = false;
+
+	static bool continues_list(std::string_view prev, std::string_view keyword) {
+		if (keyword == "BO_")
+			return prev == "BO_" || prev == "SG_";
+		return prev == keyword &&
+			(keyword == "CM_" || keyword == "BA_" || keyword == "VAL_" || keyword == "VAL_TABLE_");
+	}
+
+	void read_more() {
+		size_t size = _buf.size();
+		_buf.resize(size + _chunk_size);
+		_in.read(_buf.data() + size, std::streamsize(_chunk_size));
+		_buf.resize(size + size_t(_in.gcount()));
+		_eof = !_in;
+	}
+
+	// Finds the end of the window starting at the start of _buf.
+	void scan() {
+		while (true) {
+			std::string_view s = _buf;
+			size_t i = skip_space(s, _scanned);
+			auto keyword = token_at(s, i);
+			char last;
+			size_t next = i < s.size() ? skip_statement(s, i, last) : i;
+
+			// the statement, and any comment before it, have to be whole
+			bool whole = next < s.size() && s[next - 1] == '\n';
+			if (!whole && !_eof) {
+				read_more();
+				continue;
+			}
+			if (i == s.size()) {
+				_window = s.size();
+				return;
+			}
+			if (i >= _chunk_size && continues_list(_prev, keyword)) {
+				_window = _scanned = i;
+				return;
+			}
+			_prev = keyword;
+			_scanned = next;
+		}
+	}
+
+public:
+	window_reader(std::istream& in, size_t chunk_size) :
+		_in(in), _chunk_size(std::max<size_t>(chunk_size, 1))
+	{}
+
+	std::string_view first() {
+		scan();
+		return { _buf.data(), _window };
+	}
+
+	bool more() const { return _window < _buf.size() || !_eof; }
+
+	// Drops the current window and reads the next one.
+	std::string_view next() {
+		_buf.erase(0, _window);
+		_scanned -= _window;
+		_window = 0;
+		scan();
+		return { _buf.data(), _window };
+	}
+};
+
+// Continues the lists that reach the end of a window into the next windows.
+struct streamed_lists {
+	window_reader& reader;
+
+	template <typename Ipt, typename Parse>
+	parse_rv operator()(std::string_view rng, std::string_view, text_scratch& ts, Ipt& ipt, Parse&& parse) const {
+		while (true) {
+			auto [rest, expected] = parse(rng, ts, ipt);
+			if (!expected || !rest.empty() || !reader.more())
+				return { rest, expected };
+			rng = reader.next();
+		}
+	}
+};
+
+} // end anonymous namespace
+
+bool parse_dbc_file(const std::filesystem::path& path, interpreter ipt, dbc_sections sections) {
+	dbc_file file(path);
+	return file.valid() && parse_dbc<interpreter>(file.text(), ipt, sections);
+}
+
+bool parse_dbc_stream(std::istream& in, interpreter ipt, const dbc_stream_options& opts) {
+	window_reader reader(in, opts.chunk_size);
+	// the first window is not the whole DBC, so there's nothing to count
+	auto sections = opts.sections & ~dbc_sections::counts;
+	if (!dbc_grammar::parse_sections(reader.first(), ipt, streamed_lists{ reader }, sections))
+		return false;
+	// windows end inside lists, which are parsed to their end, so this is a misplaced statement
+	if (reader.more())
+		return syntax_error(reader.next());
+	return true;
+}
+
+} // end namespace can
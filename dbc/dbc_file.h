@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <istream>
+#include <filesystem>
+#include <string_view>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "dbc/dbc_parser.h"
+
+/*
+
+DBC input without copying the file into memory first.
+
+dbc_file maps a DBC file read-only, so parse_dbc() reads it in place from the page
+cache, which the kernel can reclaim, instead of from a heap copy.
+
+parse_dbc_stream() parses a DBC from a stream in bounded memory. It reads windows
+of about `chunk_size` bytes that end between two statements of the BO_, CM_, BA_,
+VAL_ or VAL_TABLE_ lists and parses them one at a time, so only the current window
+is in memory, and the other sections, which are whole in one window, are parsed as
+usual. The callbacks are the same as those of parse_dbc(), except for the def_counts
+hint, which needs the whole DBC. Their views are valid only during the call, as
+always, since the window they point into is reused.
+
+*/
+
+namespace can {
+
+class dbc_file {
+	std::unique_ptr<boost::interprocess::mapped_region> _region;
+	bool _valid = false;
+public:
+	// Maps the file. A missing or unreadable file leaves it invalid, an empty one has empty text.
+	explicit dbc_file(const std::filesystem::path& path) {
+		namespace bip = boost::interprocess;
+		std::error_code ec;
+		auto file_size = std::filesystem::file_size(path, ec);
+		if (ec)
+			return;
+		if (file_size > 0) {
+			try {
+				_region = std::make_unique<bip::mapped_region>(
+					bip::file_mapping(path.c_str(), bip::read_only), bip::read_only
+				);
+			}
+			catch (const bip::interprocess_exception&) {
+				return;
+			}
+			_region->advise(bip::mapped_region::advice_sequential);
+		}
+		_valid = true;
+	}
+
+	bool valid() const { return _valid; }
+
+	std::string_view text() const {
+		if (!_region)
+			return {};
+		return { static_cast<const char*>(_region->get_address()), _region->get_size() };
+	}
+};
+
+// Maps the file and parses it in place. Fails if the file can't be read.
+bool parse_dbc_file(const std::filesystem::path& path, interpreter ipt, dbc_sections sections = dbc_sections::all);
+
+struct dbc_stream_options {
+	size_t chunk_size = 1 << 20; // window size, windows are longer only for sections other than lists
+	dbc_sections sections = dbc_sections::all; // see parse_dbc(dbc_src, ipt, sections)
+};
+
+bool parse_dbc_stream(std::istream& in, interpreter ipt, const dbc_stream_options& opts = {});
+
+} // end namespace can
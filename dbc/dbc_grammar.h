@@ -0,0 +1,1380 @@
+#pragma once
+
+/*==========================================================================================
+	Copyright (c) 2001-2023 Mireo, EU
+
+	Extremely efficient DBC file format parser, built on top of Boost Spirit.
+
+	Strictly follows the grammar rules from the last updated DBC specification available at
+	http://mcu.so/Microcontroller/Automotive/dbc-file-format-documentation_compress.pdf
+
+	Header-only grammar, for parsing straight into a known interpreter type.
+===========================================================================================*/
+
+#include <cstdio>
+#include <charconv>
+#include <limits>
+#include <type_traits>
+#include <memory>
+#include <optional>
+#include <deque>
+#include <array>
+#include <algorithm>
+#include <initializer_list>
+
+#include <boost/spirit/home/x3.hpp>
+#include <boost/fusion/adapted/std_pair.hpp>
+
+#include "dbc/dbc_parser.h"
+#include "dbc/dbc_scan.h"
+
+namespace can {
+
+namespace dbc_grammar {
+
+namespace x3 = boost::spirit::x3;
+
+
+template <typename T>
+constexpr auto to(T& arg) {
+	return [&](auto& ctx) { arg = x3::_attr(ctx); };
+}
+
+template <typename T, typename Parser>
+constexpr auto as(Parser&& p) {
+	return x3::rule<struct _, T>{} = std::forward<Parser>(p);
+}
+
+template <typename T>
+constexpr auto push(std::vector<T>& arg) {
+	return [&](auto& ctx) { arg.push_back(x3::_attr(ctx)); };
+}
+
+// Sets the context parser `Tag` to the one of `parsers` that `sym` maps the input to.
+template <typename Tag, typename Symbols, typename Parsers>
+constexpr auto select_parser(Symbols&& sym, const Parsers& parsers) {
+	auto action = [&parsers](auto& ctx) { x3::get<Tag>(ctx) = parsers[x3::_attr(ctx)]; };
+	return x3::omit[sym[action]];
+}
+
+template <typename Tag>
+struct lazy_type : x3::parser<lazy_type<Tag>> {
+	using attribute_type = typename Tag::attribute_type;
+
+	template<typename It, typename Ctx, typename RCtx, typename Attr>
+	bool parse(It& first, It last, Ctx& ctx, RCtx& rctx, Attr& attr) const {
+		auto& subject = x3::get<Tag>(ctx);
+
+		It saved = first;
+		x3::skip_over(first, last, ctx);
+		bool rv = x3::as_parser(subject).parse(
+			first, last,
+			std::forward<Ctx>(ctx), std::forward<RCtx>(rctx), attr
+		);
+		if (rv) return true;
+		first = saved;
+		return false;
+	}
+};
+
+template <typename T>
+inline constexpr auto lazy = lazy_type<T>{};
+
+template <typename It>
+const char* to_ptr(It it) {
+	return std::to_address(it);
+}
+
+// Blanks, `//` comments up to the line end and closed `/* */` comments, as one run.
+struct skipper_parser : x3::parser<skipper_parser> {
+	using attribute_type = x3::unused_type;
+	static bool const has_attribute = false;
+
+	static const char* skip(const char* p, const char* e) {
+		while (true) {
+			p = dbc_scan::skip_blanks(p, e);
+			if (e - p < 2 || p[0] != '/')
+				return p;
+			if (p[1] == '/')
+				p = dbc_scan::find_eol(p + 2, e);
+			else if (auto ce = p[1] == '*' ? dbc_scan::find_comment_end(p + 2, e) : nullptr)
+				p = ce;
+			else
+				return p;
+		}
+	}
+
+	template <typename It, typename Ctx, typename RCtx, typename Attr>
+	bool parse(It& first, It last, const Ctx&, RCtx&, Attr&) const {
+		const char* b = to_ptr(first), * p = skip(b, to_ptr(last));
+		first += p - b;
+		return p != b;
+	}
+};
+
+inline constexpr auto skipper_ = skipper_parser{};
+
+inline constexpr auto end_cmd_ = x3::omit[*x3::eol];
+
+constexpr auto od(char c) {
+	return x3::omit[x3::char_(c)];
+}
+
+template <typename Attr>
+void assign_view(std::string_view v, Attr& attr) {
+	if constexpr (!std::is_same_v<Attr, x3::unused_type>)
+		attr = v;
+}
+
+// Identifier, as a view into the DBC source.
+struct name_parser : x3::parser<name_parser> {
+	using attribute_type = std::string_view;
+
+	static bool is_first(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+
+	template <typename It, typename Ctx, typename RCtx, typename Attr>
+	bool parse(It& first, It last, const Ctx& ctx, RCtx&, Attr& attr) const {
+		x3::skip_over(first, last, ctx);
+		if (first == last || !is_first(*first))
+			return false;
+		const char* b = to_ptr(first);
+		const char* e = dbc_scan::skip_name(b + 1, to_ptr(last));
+		assign_view(std::string_view(b, e), attr);
+		first += e - b;
+		return true;
+	}
+};
+
+inline constexpr auto name_ = name_parser{};
+
+// Floating point number, in the syntax of x3::double_ but correctly rounded by std::from_chars.
+// Plain integers, most factors, offsets and ranges, are converted exactly without it.
+struct real_parser : x3::parser<real_parser> {
+	using attribute_type = double;
+
+	static bool is_digit(char c) { return unsigned(c - '0') < 10; }
+
+	static constexpr double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16 };
+
+	// Value of a number too large or too small for a double, infinity or 0 like x3::double_.
+	static double out_of_range(const char* p, const char* e) {
+		long order = 0; // decimal exponent of the leading digit, plus one
+		for (; p != e && *p == '0'; ++p);
+		for (; p != e && is_digit(*p); ++p)
+			++order;
+		if (order == 0 && p != e && *p == '.')
+			for (++p; p != e && *p == '0'; ++p)
+				--order;
+		p = std::find_if(p, e, [](char c) { return c == 'e' || c == 'E'; });
+		long exp = 0;
+		if (p != e && ++p != e)
+			std::from_chars(p + (*p == '+'), e, exp);
+		return order + exp > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+	}
+
+	// the end of the number at p, or nullptr if there isn't one
+	static const char* scan(const char* p, const char* e, double& v) {
+		bool neg = p != e && *p == '-';
+		if (p != e && (*p == '-' || *p == '+'))
+			++p;
+		if (p == e || *p == '-' || *p == '+')
+			return nullptr;
+
+		// up to 19 digits fit in uint64_t and convert to double correctly rounded
+		const char* digits = p;
+		uint64_t n = 0;
+		while (p != e && p - digits < 19 && is_digit(*p))
+			n = n * 10 + unsigned(*p++ - '0');
+
+		// short decimals: n and 10^k are exact doubles, so n / 10^k is correctly rounded
+		const char* point = p;
+		if (p != e && *p == '.' && p != digits && p - digits < 16) {
+			while (++p != e && p - digits < 17 && is_digit(*p))
+				n = n * 10 + unsigned(*p - '0');
+		}
+		auto at_end = [&] { return p == e || (*p != '.' && *p != 'e' && *p != 'E' && !is_digit(*p)); };
+
+		if (p != digits && p == point && at_end())
+			v = double(n);
+		else if (p != point && p - point > 1 && at_end() && n < (uint64_t(1) << 53))
+			v = double(n) / pow10[p - point - 1];
+		else {
+			auto [end, ec] = std::from_chars(digits, e, v);
+			if (ec == std::errc::result_out_of_range)
+				v = out_of_range(digits, end);
+			else if (ec != std::errc())
+				return nullptr;
+			p = end;
+		}
+		if (neg)
+			v = -v;
+		return p;
+	}
+
+	template <typename It, typename Ctx, typename RCtx, typename Attr>
+	bool parse(It& first, It last, const Ctx& ctx, RCtx&, Attr& attr) const {
+		x3::skip_over(first, last, ctx);
+		double v;
+		const char* b = to_ptr(first), * p = scan(b, to_ptr(last), v);
+		if (!p)
+			return false;
+		x3::traits::move_to(v, attr);
+		first += p - b;
+		return true;
+	}
+};
+
+inline constexpr auto real_ = real_parser{};
+
+// Backing storage for quoted strings with escape sequences, which can't be viewed in the
+// source directly. Views stay valid until reset(), which keeps the buffers for reuse.
+class text_scratch {
+	std::deque<std::string> _bufs;
+	size_t _used = 0;
+public:
+	void reset() { _used = 0; }
+
+	std::string_view unescape(const char* b, const char* e) {
+		if (_used == _bufs.size())
+			_bufs.emplace_back();
+		auto& buf = _bufs[_used++];
+		buf.clear();
+		for (; b != e; ++b) {
+			if (*b == '\\' && b + 1 != e && (b[1] == '\\' || b[1] == '"'))
+				++b;
+			buf.push_back(*b);
+		}
+		return buf;
+	}
+};
+
+// Double-quoted string with \\ and \" escapes, as a view into the source or into text_scratch.
+struct quoted_name_parser : x3::parser<quoted_name_parser> {
+	using attribute_type = std::string_view;
+
+	text_scratch* scratch;
+
+	template <typename It, typename Ctx, typename RCtx, typename Attr>
+	bool parse(It& first, It last, const Ctx& ctx, RCtx&, Attr& attr) const {
+		x3::skip_over(first, last, ctx);
+		if (first == last || *first != '"')
+			return false;
+
+		const char* b = to_ptr(first) + 1, * e = to_ptr(last);
+		bool escaped;
+		const char* it = dbc_scan::find_quote_end(b, e, escaped);
+		if (it == e)
+			return false;
+
+		assign_view(escaped ? scratch->unescape(b, it) : std::string_view(b, it), attr);
+		first += it + 1 - to_ptr(first);
+		return true;
+	}
+};
+
+inline auto quoted_name(text_scratch& ts) {
+	return quoted_name_parser{ {}, &ts };
+}
+
+inline std::string_view skip_blines(std::string_view rng) {
+	constexpr auto eols_ = x3::omit[+x3::eol];
+	auto iter = rng.begin();
+	phrase_parse(iter, rng.end(), eols_, skipper_);
+	return { iter, rng.end() };
+}
+
+// Statically dispatched callback; compiles away if the interpreter implements
+// neither the view nor the owning callback.
+template <typename Cpo, typename Ipt, typename ...Args>
+void dispatch(Cpo cpo, Ipt& ipt, Args&& ...args) {
+	if constexpr (Cpo::template handled_by<Ipt>)
+		cpo(ipt, std::forward<Args>(args)...);
+}
+
+using parse_rv = std::pair<std::string_view, bool>;
+
+using nodes_t = x3::symbols<size_t>;
+
+using attr_val_t = attr_value_view;
+using attr_val_rule = x3::any_parser<std::string_view::const_iterator, attr_val_t>;
+
+// Value types of the attributes defined by BA_DEF_, used to pick the value parser in BA_DEF_DEF_ and BA_.
+enum attr_type : unsigned { attr_enum, attr_int, attr_float, attr_string };
+using attr_types_t = x3::symbols<attr_type>;
+
+// Value parsers indexed by attr_type. Quoted values are unescaped into `ts`.
+inline std::array<attr_val_rule, 4> attr_value_parsers(text_scratch& ts) {
+	const auto quoted_value_ = quoted_name(ts);
+	return { quoted_value_ | x3::int_, x3::int_, real_, quoted_value_ };
+}
+
+inline auto make_rv(std::string_view::iterator b, std::string_view::iterator e, bool v) {
+	return std::make_pair(std::string_view{ b, e }, v);
+}
+
+inline auto make_rv(std::string_view s, bool v) {
+	return std::make_pair(s, v);
+}
+
+template <typename Ipt>
+const parse_rv parse_version(std::string_view rng, text_scratch& ts, Ipt& ipt) {
+	bool has_sect = false;
+	std::string_view version;
+	const auto quoted_name_ = quoted_name(ts);
+
+	const auto version_ = x3::omit[x3::lexeme[x3::lit("VERSION") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> quoted_name_[to(version)] >> end_cmd_;
+
+	auto iter = rng.begin();
+	if (!phrase_parse(iter, rng.end(), version_, skipper_))
+		return make_rv(rng, !has_sect);
+
+	dispatch(def_version_view, ipt, version);
+	return make_rv(iter, rng.end(), true);
+};
+
+inline const parse_rv parse_ns_(std::string_view rng) {
+	struct ns_syms : x3::symbols<unsigned> {
+		ns_syms() {
+			add
+			("NS_DESC_", 0) ("CM_", 1) ("BA_DEF_", 2) ("BA_", 3) ("VAL_", 4)
+				("CAT_DEF_", 5)	("CAT_", 6) ("FILTER", 7) ("BA_DEF_DEF_", 8)
+				("EV_DATA_", 9)	("ENVVAR_DATA_", 10) ("SGTYPE_", 11) ("SGTYPE_VAL_", 12)
+				("BA_DEF_SGTYPE_", 13) ("BA_SGTYPE_", 14) ("SIG_TYPE_REF_", 15)
+				("VAL_TABLE_", 16) ("SIG_GROUP_", 17) ("SIG_VALTYPE_", 18)
+				("SIGTYPE_VALTYPE_", 19) ("BO_TX_BU_", 20) ("BA_DEF_REL_", 21)
+				("BA_REL_", 22) ("BA_DEF_DEF_REL_", 23) ("BU_SG_REL_", 24)
+				("BU_EV_REL_", 25) ("BU_BO_REL_", 26) ("SG_MUL_VAL_", 27);
+		}
+	} ns_syms_;
+	bool has_sect = false;
+
+	const auto ns_ = x3::omit[x3::lexeme[x3::lit("NS_") >> +x3::blank >> ':']] >>
+		x3::attr(true)[to(has_sect)] >> x3::omit[+x3::space] >>
+		x3::omit[*(ns_syms_ >> x3::omit[+x3::space])] >> end_cmd_;
+
+	auto iter = rng.begin();
+	if (!phrase_parse(iter, rng.end(), ns_, skipper_))
+		return make_rv(rng, !has_sect);
+
+	// interpreter callback deliberately omitted
+	return make_rv(iter, rng.end(), true);
+}
+
+inline const parse_rv parse_bs_(std::string_view rng) {
+	const auto bs_ = x3::omit[x3::lexeme[x3::lit("BS_:")]] >>
+		x3::omit[-(x3::uint_ >> ':' >> x3::uint_ >> ',' >> x3::uint_)] >> end_cmd_;
+
+	auto iter = rng.begin();
+	if (!phrase_parse(iter, rng.end(), bs_, skipper_))
+		return make_rv(rng, false);
+
+	// interpreter callback deliberately omitted
+	return make_rv(iter, rng.end(), true);
+};
+
+template <typename Ipt>
+const parse_rv parse_bu_(std::string_view rng, nodes_t& nodes, Ipt& ipt) {
+	std::vector<std::string_view> node_names;
+
+	const auto bu_ = x3::omit[x3::lexeme[x3::lit("BU_:")]] >>
+		*name_[push(node_names)] >> end_cmd_;
+
+	auto iter = rng.begin();
+	if (!phrase_parse(iter, rng.end(), bu_, skipper_))
+		return make_rv(rng, false);
+
+	unsigned node_ord = 0;
+	for (const auto& nn : node_names)
+		nodes.add(nn, node_ord++);
+	nodes.add("Vector__XXX", node_ord);
+
+	dispatch(def_bu_view, ipt, node_names);
+	return make_rv(iter, rng.end(), true);
+};
+
+// Fields of a BO_ statement.
+struct bo_fields {
+	uint32_t can_id;
+	std::string_view msg_name;
+	size_t msg_size;
+	size_t transmitter_ord;
+};
+
+// Fields of an SG_ statement.
+struct sg_fields {
+	std::optional<unsigned> mux_switch_val;
+	std::string_view name;
+	std::optional<char> mux_switch;
+	unsigned start_bit, size;
+	char byte_order, sign;
+	double factor, offset;
+	double min, max;
+	std::string_view unit;
+	std::vector<size_t> rec_ords;
+
+	void clear() {
+		mux_switch_val.reset();
+		mux_switch.reset();
+		rec_ords.clear();
+	}
+};
+
+// Hand-written recognizers for BO_ and SG_ statements in their canonical layout, tokens separated
+// by blanks and the statement ending its line. They return where the grammar would end the
+// statement, or nullptr for anything else, comments and extended multiplexing included, which
+// is then left to the grammar. Define DBC_NO_FAST_PATH to parse everything with the grammar.
+namespace fast_path {
+
+#ifdef DBC_NO_FAST_PATH
+inline constexpr bool enabled = false;
+#else
+inline constexpr bool enabled = true;
+#endif
+
+inline const char* char_at(const char* p, const char* e, char c) {
+	p = dbc_scan::skip_blanks(p, e);
+	return p != e && *p == c ? p + 1 : nullptr;
+}
+
+// up to 9 digits, longer numbers are left to x3::uint_ and its overflow checks
+template <typename T>
+const char* uint_at(const char* p, const char* e, T& v) {
+	p = dbc_scan::skip_blanks(p, e);
+	const char* b = p;
+	unsigned n = 0;
+	while (p != e && p - b < 9 && real_parser::is_digit(*p))
+		n = n * 10 + unsigned(*p++ - '0');
+	if (p == b || (p != e && real_parser::is_digit(*p)))
+		return nullptr;
+	v = n;
+	return p;
+}
+
+inline const char* real_at(const char* p, const char* e, double& v) {
+	return real_parser::scan(dbc_scan::skip_blanks(p, e), e, v);
+}
+
+inline const char* name_at(const char* p, const char* e, std::string_view& name) {
+	p = dbc_scan::skip_blanks(p, e);
+	if (p == e || !name_parser::is_first(*p))
+		return nullptr;
+	const char* b = p;
+	p = dbc_scan::skip_name(p + 1, e);
+	name = { b, size_t(p - b) };
+	return p;
+}
+
+// a whole name that is a node, where the grammar would also match nodes that only prefix it
+inline const char* node_at(const char* p, const char* e, const nodes_t& nodes, size_t& ord) {
+	std::string_view name;
+	if (!(p = name_at(p, e, name)))
+		return nullptr;
+	auto v = nodes.find(name);
+	if (!v)
+		return nullptr;
+	ord = *v;
+	return p;
+}
+
+inline const char* quoted_at(const char* p, const char* e, text_scratch& ts, std::string_view& text) {
+	p = dbc_scan::skip_blanks(p, e);
+	if (p == e || *p != '"')
+		return nullptr;
+	bool escaped;
+	const char* q = dbc_scan::find_quote_end(p + 1, e, escaped);
+	if (q == e)
+		return nullptr;
+	text = escaped ? ts.unescape(p + 1, q) : std::string_view(p + 1, size_t(q - p - 1));
+	return q + 1;
+}
+
+// keyword followed by a blank, as lexeme[lit(keyword) >> +blank]
+inline const char* keyword_at(const char* p, const char* e, std::string_view keyword) {
+	p = skipper_parser::skip(p, e);
+	if (size_t(e - p) <= keyword.size() || std::string_view(p, keyword.size()) != keyword)
+		return nullptr;
+	p += keyword.size();
+	return *p == ' ' || *p == '\t' ? p : nullptr;
+}
+
+// past end_cmd_ and the skipping after it, if the statement ends its line
+inline const char* line_end(const char* p, const char* e) {
+	p = skipper_parser::skip(p, e);
+	const char* b = p;
+	while (p != e && (*p == '\r' || *p == '\n')) {
+		p += *p == '\r' && p + 1 != e && p[1] == '\n' ? 2 : 1;
+		p = skipper_parser::skip(p, e);
+	}
+	return p != b || p == e ? p : nullptr;
+}
+
+inline const char* bo_line(const char* p, const char* e, const nodes_t& nodes, bo_fields& bo) {
+	(p = keyword_at(p, e, "BO_")) &&
+		(p = uint_at(p, e, bo.can_id)) &&
+		(p = name_at(p, e, bo.msg_name)) &&
+		(p = char_at(p, e, ':')) &&
+		(p = uint_at(p, e, bo.msg_size)) &&
+		(p = node_at(p, e, nodes, bo.transmitter_ord));
+	return p ? line_end(p, e) : nullptr;
+}
+
+inline const char* sg_line(const char* p, const char* e, const nodes_t& nodes, text_scratch& ts, sg_fields& sg) {
+	if (!(p = keyword_at(p, e, "SG_")) || !(p = name_at(p, e, sg.name)))
+		return nullptr;
+
+	// "M" switch or "m<value>" multiplexed signal
+	const char* q = dbc_scan::skip_blanks(p, e);
+	if (q != e && *q == 'M') {
+		sg.mux_switch = 'M';
+		p = q + 1;
+	}
+	else if (q != e && *q == 'm') {
+		unsigned val;
+		if (!(p = uint_at(q + 1, e, val)))
+			return nullptr;
+		sg.mux_switch_val = val;
+	}
+
+	(p = char_at(p, e, ':')) &&
+		(p = uint_at(p, e, sg.start_bit)) &&
+		(p = char_at(p, e, '|')) &&
+		(p = uint_at(p, e, sg.size)) &&
+		(p = char_at(p, e, '@'));
+	if (!p)
+		return nullptr;
+
+	p = dbc_scan::skip_blanks(p, e);
+	if (p == e || (*p != '0' && *p != '1'))
+		return nullptr;
+	sg.byte_order = *p++;
+	p = dbc_scan::skip_blanks(p, e);
+	if (p == e || (*p != '+' && *p != '-'))
+		return nullptr;
+	sg.sign = *p++;
+
+	(p = char_at(p, e, '(')) &&
+		(p = real_at(p, e, sg.factor)) &&
+		(p = char_at(p, e, ',')) &&
+		(p = real_at(p, e, sg.offset)) &&
+		(p = char_at(p, e, ')')) &&
+		(p = char_at(p, e, '[')) &&
+		(p = real_at(p, e, sg.min)) &&
+		(p = char_at(p, e, '|')) &&
+		(p = real_at(p, e, sg.max)) &&
+		(p = char_at(p, e, ']')) &&
+		(p = quoted_at(p, e, ts, sg.unit));
+	// a zero factor is a syntax error, reported by the grammar
+	if (!p || std::abs(sg.factor) <= std::numeric_limits<double>::epsilon())
+		return nullptr;
+
+	while (true) {
+		size_t ord;
+		if (!(p = node_at(p, e, nodes, ord)))
+			return nullptr;
+		sg.rec_ords.push_back(ord);
+		q = dbc_scan::skip_blanks(p, e);
+		if (q == e || *q != ',')
+			break;
+		p = q + 1;
+	}
+	return line_end(p, e);
+}
+
+} // end namespace fast_path
+
+template <typename Ipt>
+const parse_rv parse_sg_(
+	std::string_view rng, const nodes_t& nodes, text_scratch& ts, Ipt& ipt, uint32_t can_id
+) {
+	bool has_sect = false;
+	sg_fields sg;
+	const auto quoted_name_ = quoted_name(ts);
+
+	const auto mux_ = -(x3::char_('m') >> x3::uint_[to(sg.mux_switch_val)]) >>
+		-x3::char_('M')[to(sg.mux_switch)];
+
+	const auto sg_ = x3::omit[x3::lexeme[x3::lit("SG_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> name_[to(sg.name)] >> mux_ >>
+		od(':') >> x3::uint_[to(sg.start_bit)] >> od('|') >>
+		x3::uint_[to(sg.size)] >> od('@') >> as<char>(x3::char_('0') | x3::char_('1'))[to(sg.byte_order)] >>
+		as<char>(x3::char_('+') | x3::char_('-'))[to(sg.sign)] >>
+		od('(') >> real_[to(sg.factor)] >> od(',') >> real_[to(sg.offset)] >> od(')') >>
+		od('[') >> real_[to(sg.min)] >> od('|') >> real_[to(sg.max)] >> od(']') >>
+		quoted_name_[to(sg.unit)] >> (nodes[push(sg.rec_ords)] % ',') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		sg.clear();
+		ts.reset();
+
+		const char* end = nullptr;
+		if constexpr (fast_path::enabled) {
+			// any other statement ends the signals, as it fails the grammar's first token
+			if (!fast_path::keyword_at(to_ptr(iter), to_ptr(rng.end()), "SG_"))
+				return make_rv(iter, rng.end(), true);
+			end = fast_path::sg_line(to_ptr(iter), to_ptr(rng.end()), nodes, ts, sg);
+		}
+		if (end)
+			iter += end - to_ptr(iter);
+		else {
+			sg.clear();
+			if (!phrase_parse(iter, rng.end(), sg_, skipper_) || std::abs(sg.factor) <= std::numeric_limits<double>::epsilon())
+				return make_rv(iter, rng.end(), !has_sect);
+		}
+
+		if (sg.mux_switch.value_or(' ') == 'M')
+			dispatch(
+				def_sg_mux_view, ipt, can_id, sg.name, sg.start_bit, sg.size, sg.byte_order,
+				sg.sign, sg.unit, sg.rec_ords
+			);
+		else
+			dispatch(
+				def_sg_view, ipt, can_id, sg.mux_switch_val, sg.name, sg.start_bit, sg.size, sg.byte_order,
+				sg.sign, sg.factor, sg.offset, sg.min, sg.max, sg.unit, sg.rec_ords
+			);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_bo_(std::string_view rng, const nodes_t& nodes, text_scratch& ts, Ipt& ipt) {
+	bool has_sect = false;
+	bo_fields bo;
+
+	const auto bo_ = x3::omit[x3::lexeme[x3::lit("BO_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >>
+		x3::uint_[to(bo.can_id)] >> name_[to(bo.msg_name)] >> od(':') >>
+		x3::uint_[to(bo.msg_size)] >> nodes[to(bo.transmitter_ord)] >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		const char* end = nullptr;
+		if constexpr (fast_path::enabled) {
+			if (!fast_path::keyword_at(to_ptr(iter), to_ptr(rng.end()), "BO_"))
+				return make_rv(iter, rng.end(), true);
+			end = fast_path::bo_line(to_ptr(iter), to_ptr(rng.end()), nodes, bo);
+		}
+		if (end)
+			iter += end - to_ptr(iter);
+		else if (!phrase_parse(iter, rng.end(), bo_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		dispatch(def_bo_view, ipt, bo.can_id, bo.msg_name, bo.msg_size, bo.transmitter_ord);
+
+		auto [remain_rng, expected] = parse_sg_({ iter, rng.end() }, nodes, ts, ipt, bo.can_id);
+		if (!expected)
+			return make_rv(remain_rng, false);
+		iter = remain_rng.begin();
+	}
+
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_ev_(std::string_view rng, const nodes_t& nodes, text_scratch& ts, Ipt& ipt) {
+	bool has_sect = false;
+	std::string_view ev_name;
+	unsigned ev_type;
+	double ev_min, ev_max;
+	std::string_view ev_unit;
+	double ev_initial;
+	unsigned ev_id;
+	std::string_view ev_access_type;
+	std::vector<size_t> ev_access_nodes_ords;
+	const auto quoted_name_ = quoted_name(ts);
+
+	// the access type is the last digit of DUMMY_NODE_VECTOR[800]0-3
+	const auto to_access_type = [&](auto& ctx) {
+		auto& digit = x3::_attr(ctx);
+		ev_access_type = std::string_view(digit.begin(), digit.end());
+	};
+	const auto access_type_ = x3::lexeme[x3::lit("DUMMY_NODE_VECTOR") >>
+		-x3::lit("800") >> x3::raw[x3::char_("0-3")][to_access_type]];
+
+	const auto ev_ = x3::omit[x3::lexeme[x3::lit("EV_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >>
+		name_[to(ev_name)] >> od(':') >> &x3::char_("0-2") >> x3::uint_[to(ev_type)] >>
+		od('[') >> real_[to(ev_min)] >> od('|') >> real_[to(ev_max)] >> od(']') >>
+		quoted_name_[to(ev_unit)] >> real_[to(ev_initial)] >> x3::uint_[to(ev_id)] >>
+		access_type_ >> (nodes[push(ev_access_nodes_ords)] % ',') >> od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		ev_access_nodes_ords.clear();
+		ts.reset();
+
+		if (!phrase_parse(iter, rng.end(), ev_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		dispatch(
+			def_ev_view, ipt, ev_name, ev_type, ev_min, ev_max, ev_unit,
+			ev_initial, ev_id, ev_access_type, ev_access_nodes_ords
+		);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_envvar_data_(std::string_view rng, Ipt& ipt) {
+	bool has_sect = false;
+	std::string_view ev_name;
+	unsigned data_size;
+
+	const auto envar_data_ = x3::omit[x3::lexeme[x3::lit("ENVVAR_DATA_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> name_[to(ev_name)] >> od(':') >>
+		x3::uint_[to(data_size)] >> od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		if (!phrase_parse(iter, rng.end(), envar_data_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		dispatch(def_envvar_data_view, ipt, ev_name, data_size);
+	}
+
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_sgtype_(std::string_view rng, const nodes_t& val_tables, text_scratch& ts, Ipt& ipt) {
+	bool has_sect = false;
+	std::optional<unsigned> msg_id;
+	std::string_view sg_name, sg_type_name;
+	unsigned sg_size;
+	char sg_byte_order, sg_sign;
+	double sg_factor, sg_offset;
+	double sg_min, sg_max;
+	std::string_view sg_unit;
+	double sg_default_val;
+	size_t val_table_ord;
+	const auto quoted_name_ = quoted_name(ts);
+
+	const auto sg_type_t_ = name_[to(sg_type_name)] >> od(':') >> x3::uint_[to(sg_size)] >>
+		od('@') >> as<char>(x3::char_('0') | x3::char_('1'))[to(sg_byte_order)] >>
+		as<char>(x3::char_('+') | x3::char_('-'))[to(sg_sign)] >> od('(') >>
+		real_[to(sg_factor)] >> od(',') >> real_[to(sg_offset)] >> od(')') >>
+		od('[') >> real_[to(sg_min)] >> od('|') >> real_[to(sg_max)] >>
+		od(']') >> quoted_name_[to(sg_unit)] >> real_[to(sg_default_val)] >>
+		od(',') >> val_tables[to(val_table_ord)];
+
+	const auto sg_type_ref_ = x3::uint_[to(msg_id)] >> name_[to(sg_name)] >>
+		od(':') >> name_[to(sg_type_name)];
+
+	const auto sg_type_ = x3::omit[x3::lexeme[x3::lit("SGTYPE_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> (sg_type_t_ | sg_type_ref_) >> od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		msg_id.reset();
+		ts.reset();
+
+		if (!phrase_parse(iter, rng.end(), sg_type_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		if (msg_id.has_value()) {
+			dispatch(def_sgtype_ref_view, ipt, msg_id.value(), sg_name, sg_type_name);
+		}
+		else {
+			dispatch(
+				def_sgtype_view, ipt, sg_type_name, sg_size, sg_byte_order, sg_sign, sg_factor, sg_offset,
+				sg_min, sg_max, sg_unit, sg_default_val, val_table_ord
+			);
+		}
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_sig_group_(std::string_view rng, Ipt& ipt) {
+	bool has_sect = false;
+	unsigned msg_id;
+	std::string_view sig_group_name;
+	unsigned repetitions;
+	std::vector<std::string_view> sig_names;
+
+	const auto sig_group_ = x3::omit[x3::lexeme[x3::lit("SIG_GROUP_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> x3::uint_[to(msg_id)] >> name_[to(sig_group_name)] >>
+		x3::uint_[to(repetitions)] >> od(':') >> (name_[push(sig_names)] % ',') >> od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		sig_names.clear();
+
+		if (!phrase_parse(iter, rng.end(), sig_group_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		dispatch(def_sig_group_view, ipt, msg_id, sig_group_name, repetitions, sig_names);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_cm_(std::string_view rng, const nodes_t& nodes, text_scratch& ts, Ipt& ipt) {
+	bool has_sect = false;
+	std::string object_type;
+	std::string_view comment_text;
+
+	unsigned bu_ord;
+	uint32_t message_id;
+	std::string_view object_name;
+
+	const auto comment_ = quoted_name(ts);
+
+	const auto cm_glob_ = comment_[to(comment_text)];
+	const auto cm_bu_ = x3::lexeme[x3::string("BU_")[to(object_type)] >> +x3::blank] >>
+		nodes[to(bu_ord)] >> comment_[to(comment_text)];
+	const auto cm_sg_ = x3::lexeme[x3::string("SG_")[to(object_type)] >> +x3::blank] >>
+		x3::uint_[to(message_id)] >> name_[to(object_name)] >> comment_[to(comment_text)];
+	const auto cm_bo_ = x3::lexeme[x3::string("BO_")[to(object_type)] >> +x3::blank] >>
+		x3::uint_[to(message_id)] >> comment_[to(comment_text)];
+	const auto cm_ev_ = x3::lexeme[x3::string("EV_")[to(object_type)] >> +x3::blank] >>
+		name_[to(object_name)] >> comment_[to(comment_text)];
+
+	const auto cm_ = x3::omit[x3::lexeme[x3::lit("CM_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> (cm_sg_ | cm_bo_ | cm_bu_ | cm_ev_ | cm_glob_) >>
+		od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		object_type.clear();
+		ts.reset();
+
+		if (!phrase_parse(iter, rng.end(), cm_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		if (object_type.empty())
+			dispatch(def_cm_glob_view, ipt, comment_text);
+		else if (object_type == "BU_")
+			dispatch(def_cm_bu_view, ipt, bu_ord, comment_text);
+		else if (object_type == "BO_")
+			dispatch(def_cm_bo_view, ipt, message_id, comment_text);
+		else if (object_type == "SG_")
+			dispatch(def_cm_sg_view, ipt, message_id, object_name, comment_text);
+		else if (object_type == "EV_")
+			dispatch(def_cm_ev_view, ipt, object_name, comment_text);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_ba_def_(std::string_view rng, attr_types_t& ats_, text_scratch& ts, Ipt& ipt) {
+	bool has_sect = false;
+	std::string object_type, data_type;
+	std::string_view attr_name;
+	int32_t int_min, int_max;
+	double dbl_min, dbl_max;
+	std::vector<std::string_view> enum_vals;
+	const auto quoted_name_ = quoted_name(ts);
+
+	const auto obj_type_ =
+		as<std::string>(x3::lexeme[
+			(x3::string("BU_") | x3::string("BO_") | x3::string("SG_") | x3::string("EV_")) >>
+				x3::omit[+x3::blank]
+		]);
+
+	const auto att_hexint_ =
+		as<std::string>(x3::lexeme[x3::string("HEX") | x3::string("INT")])[to(data_type)] >>
+		x3::int_[to(int_min)] >> x3::int_[to(int_max)];
+
+	const auto att_float_ =
+		as<std::string>(x3::lexeme[x3::lit("FLOAT")])[to(data_type)] >>
+		real_[to(dbl_min)] >> real_[to(dbl_max)];
+
+	const auto att_str_ =
+		as<std::string>(x3::lexeme[x3::lit("STRING")])[to(data_type)];
+
+	const auto att_enum_ =
+		as<std::string>(x3::lexeme[x3::lit("ENUM")])[to(data_type)] >>
+		-(quoted_name_[push(enum_vals)] % ',');
+
+
+	const auto ba_def_ = x3::omit[x3::lexeme[x3::lit("BA_DEF_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >>
+		-obj_type_[to(object_type)] >> quoted_name_[to(attr_name)] >>
+		(att_hexint_ | att_float_ | att_str_ | att_enum_) >> od(';') >>
+		end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		object_type.clear();
+		enum_vals.clear();
+		ts.reset();
+
+		if (!phrase_parse(iter, rng.end(), ba_def_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		auto quoted_attr_name = "\"" + std::string(attr_name) + "\"";
+		if (data_type == "ENUM") {
+			ats_.add(quoted_attr_name, attr_enum);
+			dispatch(def_ba_def_enum_view, ipt, attr_name, object_type, enum_vals);
+		}
+		else if (data_type == "INT" || data_type == "HEX") {
+			ats_.add(quoted_attr_name, attr_int);
+			dispatch(def_ba_def_int_view, ipt, attr_name, object_type, int_min, int_max);
+		}
+		else if (data_type == "FLOAT") {
+			ats_.add(quoted_attr_name, attr_float);
+			dispatch(def_ba_def_float_view, ipt, attr_name, object_type, dbl_min, dbl_max);
+		}
+		else if (data_type == "STRING") {
+			ats_.add(quoted_attr_name, attr_string);
+			dispatch(def_ba_def_string_view, ipt, attr_name, object_type);
+		}
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_ba_def_def_(std::string_view rng, const attr_types_t& ats_, text_scratch& ts, Ipt& ipt) {
+	bool has_sect = false;
+	std::string_view attr_name;
+	attr_val_t attr_val;
+	const auto quoted_name_ = quoted_name(ts);
+	const auto attr_parsers = attr_value_parsers(ts);
+
+	const auto val_ = x3::with<attr_val_rule>(attr_val_rule{})[
+		&select_parser<attr_val_rule>(ats_, attr_parsers) >> quoted_name_[to(attr_name)] >>
+			lazy<attr_val_rule>[to(attr_val)]
+	];
+
+	const auto ba_def_def_ = x3::with<attr_val_rule>(attr_val_rule{})[
+		x3::omit[x3::lexeme[(x3::string("BA_DEF_DEF_REL_") | x3::string("BA_DEF_DEF_")) >> +x3::blank]] >>
+			x3::attr(true)[to(has_sect)] >> val_ >> od(';') >> end_cmd_
+	];
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		ts.reset();
+
+		if (!phrase_parse(iter, rng.end(), ba_def_def_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		dispatch(def_ba_def_def_view, ipt, attr_name, attr_val);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_ba_(
+	std::string_view rng, const nodes_t& nodes,
+	const attr_types_t& ats_, text_scratch& ts, Ipt& ipt
+) {
+	bool has_sect = false;
+	std::string object_type;
+	std::string_view attr_name;
+	attr_val_t attr_val;
+
+	unsigned bu_ord;
+	uint32_t message_id;
+	std::string_view object_name;
+	const auto quoted_name_ = quoted_name(ts);
+	const auto attr_parsers = attr_value_parsers(ts);
+
+	const auto av_glob_ = lazy<attr_val_rule>[to(attr_val)];
+	const auto av_bu_ = x3::lexeme[x3::string("BU_")[to(object_type)] >> +x3::blank] >>
+		nodes[to(bu_ord)] >> lazy<attr_val_rule>[to(attr_val)];
+	const auto av_sg_ = x3::lexeme[x3::string("SG_")[to(object_type)] >> +x3::blank] >>
+		x3::uint_[to(message_id)] >> name_[to(object_name)] >> lazy<attr_val_rule>[to(attr_val)];
+	const auto av_bo_ = x3::lexeme[x3::string("BO_")[to(object_type)] >> +x3::blank] >>
+		x3::uint_[to(message_id)] >> lazy<attr_val_rule>[to(attr_val)];
+	const auto av_ev_ = x3::lexeme[x3::string("EV_")[to(object_type)] >> +x3::blank] >>
+		name_[to(object_name)] >> lazy<attr_val_rule>[to(attr_val)];
+
+	const auto ba_ = x3::with<attr_val_rule>(attr_val_rule{})[
+		x3::omit[x3::lexeme[x3::lit("BA_") >> +x3::blank]] >> x3::attr(true)[to(has_sect)] >>
+			&select_parser<attr_val_rule>(ats_, attr_parsers) >> quoted_name_[to(attr_name)] >>
+			(av_sg_ | av_bo_ | av_bu_ | av_ev_ | av_glob_) >> od(';') >> end_cmd_
+	];
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		object_type.clear();
+		object_name = {};
+		bu_ord = 0;
+		message_id = 0;
+		ts.reset();
+
+		if (!phrase_parse(iter, rng.end(), ba_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		// TODO: can break this up into multiple CPOs
+
+		dispatch(def_ba_view, ipt, attr_name, object_type, object_name, bu_ord, message_id, attr_val);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_val_(std::string_view rng, text_scratch& ts, Ipt& ipt) {
+	bool has_sect = false;
+	std::string_view signal_name, env_var_name;
+	std::optional<uint32_t> msg_id;
+	unsigned val;
+	std::vector<val_desc_view> val_descs;
+	const auto quoted_name_ = quoted_name(ts);
+
+	const auto push_desc = [&](auto& ctx) { val_descs.emplace_back(val, x3::_attr(ctx)); };
+	const auto val_ = x3::omit[x3::lexeme[x3::lit("VAL_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >>
+		(name_[to(env_var_name)] | (x3::uint_[to(msg_id)] >> name_[to(signal_name)])) >>
+		*(x3::uint_[to(val)] >> quoted_name_[push_desc]) >>
+		od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		msg_id.reset();
+		val_descs.clear();
+		ts.reset();
+
+		if (!phrase_parse(iter, rng.end(), val_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		if (!msg_id.has_value())
+			dispatch(def_val_env_view, ipt, env_var_name, val_descs);
+		else
+			dispatch(def_val_sg_view, ipt, msg_id.value(), signal_name, val_descs);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+// `val_table_ord` numbers the tables, and continues over calls for the rest of the list.
+template <typename Ipt>
+const parse_rv parse_val_table_(std::string_view rng, nodes_t& val_tables, unsigned& val_table_ord, text_scratch& ts, Ipt& ipt) {
+	bool has_sect = false;
+	std::string_view table_name;
+	unsigned val;
+	std::vector<val_desc_view> val_descs;
+	const auto quoted_name_ = quoted_name(ts);
+
+	const auto push_desc = [&](auto& ctx) { val_descs.emplace_back(val, x3::_attr(ctx)); };
+	const auto val_table_ = x3::omit[x3::lexeme[x3::lit("VAL_TABLE_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> name_[to(table_name)] >>
+		*(x3::uint_[to(val)] >> quoted_name_[push_desc]) >>
+		od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		val_descs.clear();
+		ts.reset();
+
+		if (!phrase_parse(iter, rng.end(), val_table_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		val_tables.add(table_name, val_table_ord++);
+
+		dispatch(def_val_table_view, ipt, table_name, val_descs);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_sig_valtype_(std::string_view rng, Ipt& ipt) {
+	bool has_sect = false;
+	unsigned msg_id;
+	std::string_view sig_name;
+	unsigned sig_ext_val_type;
+
+	const auto sig_valtype_ = x3::omit[x3::lexeme[x3::lit("SIG_VALTYPE_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> x3::uint_[to(msg_id)] >> name_[to(sig_name)] >>
+		od(':') >> &x3::char_("0-3") >> x3::uint_[to(sig_ext_val_type)] >> od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		if (!phrase_parse(iter, rng.end(), sig_valtype_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		dispatch(def_sig_valtype_view, ipt, msg_id, sig_name, sig_ext_val_type);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_bo_tx_bu(std::string_view rng, Ipt& ipt) {
+	bool has_sect = false;
+	unsigned msg_id;
+	std::vector<std::string_view> transmitters;
+
+	const auto sig_valtype_ = x3::omit[x3::lexeme[x3::lit("BO_TX_BU_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> x3::uint_[to(msg_id)] >> od(':') >>
+		(name_[push(transmitters)] % ',') >> od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		transmitters.clear();
+
+		if (!phrase_parse(iter, rng.end(), sig_valtype_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		dispatch(def_bo_tx_bu_view, ipt, msg_id, transmitters);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+template <typename Ipt>
+const parse_rv parse_sg_mul_val_(std::string_view rng, Ipt& ipt) {
+	using value_range = std::pair<unsigned, unsigned>;
+
+	bool has_sect = false;
+	unsigned msg_id;
+	std::string_view mux_sig_name, mux_switch_name;
+	unsigned range_begin;
+	std::vector<value_range> val_ranges;
+
+	const auto push_range = [&](auto& ctx) { val_ranges.emplace_back(range_begin, x3::_attr(ctx)); };
+	const auto val_range_ = x3::uint_[to(range_begin)] >> od('-') >> x3::uint_[push_range];
+
+	const auto sg_mul_val_ = x3::omit[x3::lexeme[x3::lit("SG_MUL_VAL_") >> +x3::blank]] >>
+		x3::attr(true)[to(has_sect)] >> x3::uint_[to(msg_id)] >>
+		name_[to(mux_sig_name)] >> name_[to(mux_switch_name)] >>
+		(val_range_ % ',') >> od(';') >> end_cmd_;
+
+	for (auto iter = rng.begin(); iter != rng.end(); has_sect = false) {
+		val_ranges.clear();
+
+		if (!phrase_parse(iter, rng.end(), sg_mul_val_, skipper_))
+			return make_rv(iter, rng.end(), !has_sect);
+
+		dispatch(def_sg_mul_val_view, ipt, msg_id, mux_sig_name, mux_switch_name, val_ranges);
+	}
+	return make_rv(rng.end(), rng.end(), true);
+}
+
+// Statement scanning without the grammar, for skipping and splitting sections.
+
+inline bool at_comment(std::string_view s, size_t i) {
+	return s[i] == '/' && i + 1 < s.size() && (s[i + 1] == '/' || s[i + 1] == '*');
+}
+
+inline size_t skip_comment(std::string_view s, size_t i) {
+	const char* e = s.data() + s.size();
+	if (s[i + 1] == '/')
+		return dbc_scan::find_eol(s.data() + i + 2, e) - s.data();
+	auto ce = dbc_scan::find_comment_end(s.data() + i + 2, e);
+	return ce ? ce - s.data() : s.size();
+}
+
+// skips blanks, line ends and comments up to the next token
+inline size_t skip_space(std::string_view s, size_t i) {
+	while (i < s.size()) {
+		i = dbc_scan::find_first_not_of<' ', '\t', '\r', '\n'>(s.data() + i, s.data() + s.size()) - s.data();
+		if (i < s.size() && at_comment(s, i))
+			i = skip_comment(s, i);
+		else
+			break;
+	}
+	return i;
+}
+
+// Skips to the start of the next line, over quoted strings and block comments spanning lines.
+// `last` is set to the last character outside comments, or to 0 if a string isn't closed.
+inline size_t skip_statement(std::string_view s, size_t i, char& last) {
+	auto is_blank = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+	last = 0;
+	while (i < s.size()) {
+		// plain text up to the next line end, string or comment
+		size_t b = i;
+		i = dbc_scan::find_first_of<'\n', '"', '/'>(s.data() + i, s.data() + s.size()) - s.data();
+		for (size_t e = i; e > b; --e) {
+			if (!is_blank(s[e - 1])) {
+				last = s[e - 1];
+				break;
+			}
+		}
+		if (i == s.size())
+			break;
+
+		if (s[i] == '\n')
+			return i + 1;
+		if (s[i] == '"') {
+			bool escaped;
+			i = dbc_scan::find_quote_end(s.data() + i + 1, s.data() + s.size(), escaped) - s.data();
+			if (i == s.size())
+				return last = 0, i;
+			last = s[i++];
+		}
+		else if (at_comment(s, i))
+			i = skip_comment(s, i);
+		else
+			last = s[i++];
+	}
+	return s.size();
+}
+
+inline std::string_view token_at(std::string_view s, size_t i) {
+	return s.substr(i, dbc_scan::skip_name(s.data() + i, s.data() + s.size()) - (s.data() + i));
+}
+
+// Skips a section without parsing it: its statements start with one of `keywords`, close their
+// strings and, if `terminated`, end with ';'. The section ends at the first other keyword.
+inline parse_rv skip_section(std::string_view rng, std::initializer_list<std::string_view> keywords, bool terminated = true) {
+	for (size_t i = skip_space(rng, 0); i < rng.size();) {
+		auto token = token_at(rng, i);
+		if (std::find(keywords.begin(), keywords.end(), token) == keywords.end())
+			return { rng.substr(i), true };
+
+		char last;
+		size_t next = skip_statement(rng, i, last);
+		if (last == 0 || (terminated && last != ';'))
+			return { rng.substr(i), false };
+		i = skip_space(rng, next);
+	}
+	return { rng.substr(rng.size()), true };
+}
+
+// Counts the lines starting with BO_ and SG_, for the def_counts hint.
+inline std::pair<size_t, size_t> count_bo_sg(std::string_view dbc_src) {
+	size_t messages = 0, signals = 0;
+	const char* p = dbc_src.data();
+	const char* e = p + dbc_src.size();
+	while (p != e) {
+		p = dbc_scan::skip_blanks(p, e);
+		if (e - p > 3 && p[2] == '_' && (p[3] == ' ' || p[3] == '\t')) {
+			messages += p[0] == 'B' && p[1] == 'O';
+			signals += p[0] == 'S' && p[1] == 'G';
+		}
+		p = dbc_scan::find_eol(p, e);
+		if (p != e)
+			++p;
+	}
+	return { messages, signals };
+}
+
+inline bool syntax_error(std::string_view where, std::string_view what = "") {
+	auto eol = where.find('\n');
+	std::string_view line{
+		where.begin(),
+		eol != std::string_view::npos ? where.begin() + eol : where.end()
+	};
+	fprintf(stderr, "Syntax error: %s\n => %s\n", what.data(), std::string(line).c_str());
+	return false;
+}
+
+// Parses the lists of statements (BO_ with their SG_, CM_, BA_, VAL_ and VAL_TABLE_) on the calling thread.
+struct serial_lists {
+	template <typename Ipt, typename Parse>
+	parse_rv operator()(std::string_view rng, std::string_view, text_scratch& ts, Ipt& ipt, Parse&& parse) const {
+		return parse(rng, ts, ipt);
+	}
+};
+
+// Parses the DBC sections in order. `parse_list(rng, keyword, ts, ipt, parse)` parses the lists
+// of statements with `parse(rng, ts, ipt)`, which is generic in the interpreter type, and may
+// continue them past the end of `rng`, see dbc_file.cpp. The statements of a list are
+// independent, but for VAL_TABLE_, which numbers its tables in order, see dbc_parallel.cpp.
+// Sections not in `sections`, and not needed to parse the ones in it, are skipped. The def_counts hint counts `dbc_src`.
+template <typename T, typename ListParser>
+bool parse_sections(std::string_view dbc_src, T& ipt, ListParser&& parse_list, dbc_sections sections) {
+	auto wants = [sections](dbc_sections s) { return contains(sections, s); };
+	auto pv = skip_blines(dbc_src);
+	bool expected = true;
+	text_scratch ts;
+
+	if constexpr (def_counts_view_cpo::handled_by<T>) {
+		if (wants(dbc_sections::counts)) {
+			auto [messages, signals] = count_bo_sg(dbc_src);
+			def_counts_view(ipt, messages, signals);
+		}
+	}
+
+	if (std::tie(pv, expected) = parse_version(pv, ts, ipt); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = parse_ns_(pv); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = parse_bs_(pv); !expected)
+		return syntax_error(pv, "(expected correct BS_)");
+
+	nodes_t nodes;
+
+	if (std::tie(pv, expected) = parse_bu_(pv, nodes, ipt); !expected)
+		return syntax_error(pv, "(expected correct BU_)");
+
+	nodes_t val_tables;
+	unsigned val_table_ord = 0;
+
+	auto val_table_list = [&](std::string_view rng, text_scratch& scratch, auto& out) {
+		return wants(dbc_sections::val_table | dbc_sections::sgtype) ?
+			parse_val_table_(rng, val_tables, val_table_ord, scratch, out) : skip_section(rng, { "VAL_TABLE_" });
+	};
+	if (std::tie(pv, expected) = parse_list(pv, "VAL_TABLE_", ts, ipt, val_table_list); !expected)
+		return syntax_error(pv);
+
+	auto bo_list = [&](std::string_view rng, text_scratch& scratch, auto& out) {
+		return wants(dbc_sections::bo | dbc_sections::sg) ?
+			parse_bo_(rng, nodes, scratch, out) : skip_section(rng, { "BO_", "SG_" }, false);
+	};
+	if (std::tie(pv, expected) = parse_list(pv, "BO_", ts, ipt, bo_list); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = wants(dbc_sections::bo_tx_bu) ?
+		parse_bo_tx_bu(pv, ipt) : skip_section(pv, { "BO_TX_BU_" }); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = wants(dbc_sections::ev) ?
+		parse_ev_(pv, nodes, ts, ipt) : skip_section(pv, { "EV_" }); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = wants(dbc_sections::envvar_data) ?
+		parse_envvar_data_(pv, ipt) : skip_section(pv, { "ENVVAR_DATA_" }); !expected)
+		return syntax_error(pv);
+
+	// VAL_ statements come before SGTYPE_ or after BA_
+	auto val_list = [&](std::string_view rng, text_scratch& scratch, auto& out) {
+		return wants(dbc_sections::val) ? parse_val_(rng, scratch, out) : skip_section(rng, { "VAL_" });
+	};
+	if (std::tie(pv, expected) = parse_list(pv, "VAL_", ts, ipt, val_list); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = wants(dbc_sections::sgtype) ?
+		parse_sgtype_(pv, val_tables, ts, ipt) : skip_section(pv, { "SGTYPE_" }); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = wants(dbc_sections::sig_group) ?
+		parse_sig_group_(pv, ipt) : skip_section(pv, { "SIG_GROUP_" }); !expected)
+		return syntax_error(pv);
+
+	auto cm_list = [&](std::string_view rng, text_scratch& scratch, auto& out) {
+		return wants(dbc_sections::cm) ? parse_cm_(rng, nodes, scratch, out) : skip_section(rng, { "CM_" });
+	};
+	if (std::tie(pv, expected) = parse_list(pv, "CM_", ts, ipt, cm_list); !expected)
+		return syntax_error(pv);
+
+	attr_types_t attr_types;
+
+	if (std::tie(pv, expected) = wants(dbc_sections::ba_def | dbc_sections::ba_def_def | dbc_sections::ba) ?
+		parse_ba_def_(pv, attr_types, ts, ipt) : skip_section(pv, { "BA_DEF_" }); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = wants(dbc_sections::ba_def_def) ?
+		parse_ba_def_def_(pv, attr_types, ts, ipt) : skip_section(pv, { "BA_DEF_DEF_", "BA_DEF_DEF_REL_" }); !expected)
+		return syntax_error(pv);
+
+	auto ba_list = [&](std::string_view rng, text_scratch& scratch, auto& out) {
+		return wants(dbc_sections::ba) ? parse_ba_(rng, nodes, attr_types, scratch, out) : skip_section(rng, { "BA_" });
+	};
+	if (std::tie(pv, expected) = parse_list(pv, "BA_", ts, ipt, ba_list); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = parse_list(pv, "VAL_", ts, ipt, val_list); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = wants(dbc_sections::sig_valtype) ?
+		parse_sig_valtype_(pv, ipt) : skip_section(pv, { "SIG_VALTYPE_" }); !expected)
+		return syntax_error(pv);
+
+	if (std::tie(pv, expected) = wants(dbc_sections::sg_mul_val) ?
+		parse_sg_mul_val_(pv, ipt) : skip_section(pv, { "SG_MUL_VAL_" }); !expected)
+		return syntax_error(pv);
+
+	if (!pv.empty())
+		return syntax_error(pv);
+
+	return true;
+}
+
+} // end namespace dbc_grammar
+
+// Parses the DBC with callbacks dispatched statically to `ipt`. Callbacks T doesn't
+// implement compile away; the type-erased parse_dbc(dbc_src, interpreter) is this
+// function instantiated for `interpreter`.
+template <typename T>
+bool parse_dbc(std::string_view dbc_src, T& ipt) {
+	return dbc_grammar::parse_sections(dbc_src, ipt, dbc_grammar::serial_lists{}, dbc_sections::all);
+}
+
+// Parses only `sections`, and those they depend on, with the grammar and skips the others.
+// handled_sections<T> are the sections T has callbacks for.
+template <typename T>
+bool parse_dbc(std::string_view dbc_src, T& ipt, dbc_sections sections) {
+	return dbc_grammar::parse_sections(dbc_src, ipt, dbc_grammar::serial_lists{}, sections);
+}
+
+} // end namespace can
@@ -0,0 +1,167 @@
+#include <atomic>
+
+#include "dbc_parallel.h"
+#include "dbc_grammar.h"
+#include "dbc_cache.h"
+#include "dbc_file.h"
+
+namespace can {
+
+namespace {
+
+using namespace dbc_grammar;
+
+// The start of the first line at or after `i`.
+size_t line_at(std::string_view rng, size_t i) {
+	if (i == 0)
+		return 0;
+	size_t eol = rng.find('\n', i - 1);
+	return eol == std::string_view::npos ? rng.size() : eol + 1;
+}
+
+// The first token of the line starting at `i`, empty for blank and comment lines.
+std::string_view line_token(std::string_view rng, size_t i) {
+	while (i < rng.size() && (rng[i] == ' ' || rng[i] == '\t'))
+		++i;
+	return token_at(rng, i);
+}
+
+// Whether the first line with a token at or after `i` continues the list. A line inside a
+// string or comment spanning lines may be taken for either, which only moves the estimate.
+bool in_list(std::string_view rng, size_t i, std::string_view keyword, std::string_view nested) {
+	for (size_t l = line_at(rng, i); l < rng.size(); l = line_at(rng, l + 1)) {
+		auto token = line_token(rng, l);
+		if (!token.empty())
+			return token == keyword || (!nested.empty() && token == nested);
+	}
+	return false;
+}
+
+// Estimates where the list of `keyword` statements at the start of `rng` ends with a binary
+// search on in_list(), which reads a line per probe instead of the whole list.
+size_t estimate_list_end(std::string_view rng, std::string_view keyword, std::string_view nested, size_t precision) {
+	size_t lo = 0, hi = rng.size();
+	while (hi - lo > precision) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (in_list(rng, mid, keyword, nested))
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return hi;
+}
+
+// Splits the list into one chunk per thread, or none for short lists. The chunks start at
+// `k * size / n`, moved forward to the next line starting with `keyword`. Such a line may be
+// inside a string or comment spanning lines, the caller checks that every chunk but the last
+// parses to its end.
+std::vector<std::string_view> split_list(std::string_view rng, std::string_view keyword, const dbc_parse_options& opts) {
+	std::string_view nested = keyword == "BO_" ? "SG_" : "";
+	size_t chunk_size = std::max<size_t>(opts.min_chunk_size, 1);
+	size_t list_size = estimate_list_end(rng, keyword, nested, chunk_size / 16 + 1);
+	size_t n = std::min<size_t>(std::max(1u, opts.threads), list_size / chunk_size);
+	if (n < 2)
+		return {};
+
+	std::vector<std::string_view> chunks;
+	size_t begin = 0;
+	for (size_t k = 1; k < n; ++k) {
+		size_t start = line_at(rng, std::max(k * list_size / n, begin + 1));
+		while (start < list_size && line_token(rng, start) != keyword)
+			start = line_at(rng, start + 1);
+		if (start >= list_size)
+			break;
+		chunks.push_back(rng.substr(begin, start - begin));
+		begin = start;
+	}
+	chunks.push_back(rng.substr(begin));
+	return chunks;
+}
+
+struct parallel_lists {
+	const dbc_parse_options& opts;
+
+	template <typename Ipt, typename Parse>
+	parse_rv operator()(
+		std::string_view rng, std::string_view keyword, text_scratch& ts, Ipt& ipt, Parse&& parse
+	) const {
+		// too short to split, without looking at the list; value tables are numbered in order
+		if (opts.threads < 2 || rng.size() < 2 * opts.min_chunk_size || keyword == "VAL_TABLE_")
+			return parse(rng, ts, ipt);
+
+		auto chunks = split_list(rng, keyword, opts);
+		if (chunks.size() < 2)
+			return parse(rng, ts, ipt);
+
+		// the list ends in the last chunk, the others are parsed to their ends
+		std::vector<dbc_recorder> recs(chunks.size());
+		std::vector<char> parsed(chunks.size());
+		std::string_view rest;
+		auto work = [&](size_t i) {
+			text_scratch chunk_ts;
+			auto [chunk_rest, expected] = parse(chunks[i], chunk_ts, recs[i]);
+			if (i + 1 < chunks.size())
+				parsed[i] = expected && chunk_rest.empty();
+			else
+				parsed[i] = expected, rest = chunk_rest;
+		};
+
+		std::vector<std::jthread> workers;
+		for (size_t i = 1; i < chunks.size(); ++i)
+			workers.emplace_back(work, i);
+		work(0);
+		workers.clear();
+
+		// nothing has reached the interpreter yet, so the list can be parsed again for the error
+		if (std::find(parsed.begin(), parsed.end(), false) != parsed.end())
+			return parse(rng, ts, ipt);
+
+		for (const auto& rec : recs)
+			replay_dbc_records(rec.records(), std::ref(ipt));
+		return { rng.substr(rest.data() - rng.data()), true };
+	}
+};
+
+// Runs work(i) for i in [0, n) on up to `threads` threads.
+template <typename Work>
+void for_each_index(size_t n, unsigned threads, Work&& work) {
+	std::atomic<size_t> next = 0;
+	auto worker = [&] {
+		for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;)
+			work(i);
+	};
+
+	std::vector<std::jthread> workers;
+	for (size_t i = 1; i < std::min<size_t>(std::max(1u, threads), n); ++i)
+		workers.emplace_back(worker);
+	worker();
+}
+
+} // end anonymous namespace
+
+bool parse_dbc_parallel(std::string_view dbc_src, interpreter ipt, const dbc_parse_options& opts) {
+	return dbc_grammar::parse_sections(dbc_src, ipt, parallel_lists{ opts }, opts.sections);
+}
+
+std::vector<bool> parse_dbcs(
+	std::span<const std::string_view> dbc_srcs, std::span<interpreter> ipts, const dbc_parse_options& opts
+) {
+	std::vector<char> parsed(std::min(dbc_srcs.size(), ipts.size()));
+	for_each_index(parsed.size(), opts.threads, [&](size_t i) {
+		parsed[i] = parse_dbc<interpreter>(dbc_srcs[i], ipts[i], opts.sections);
+	});
+	return { parsed.begin(), parsed.end() };
+}
+
+std::vector<bool> parse_dbc_files(
+	std::span<const std::filesystem::path> paths, std::span<interpreter> ipts, const dbc_parse_options& opts
+) {
+	std::vector<char> parsed(std::min(paths.size(), ipts.size()));
+	for_each_index(parsed.size(), opts.threads, [&](size_t i) {
+		dbc_file file(paths[i]);
+		parsed[i] = file.valid() && parse_dbc<interpreter>(file.text(), ipts[i], opts.sections);
+	});
+	return { parsed.begin(), parsed.end() };
+}
+
+} // end namespace can
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+
+#include "dbc/dbc_parser.h"
+
+/*
+
+Parallel DBC parsing, for loading large DBCs or many of them at once.
+
+parse_dbc_parallel() splits the DBC's long lists of independent statements, BO_
+messages with their SG_ signals, CM_ comments, BA_ attribute values and VAL_ value
+descriptions, into one chunk per thread. The end of a list is estimated with a
+binary search that reads a line per probe, and the chunks start at the first line
+beginning with the list's keyword after equal shares of it, so the list isn't
+scanned before it is parsed.
+The chunks are parsed on `threads` threads into dbc_recorders, and the recorded
+callbacks are then replayed to the interpreter in source order, so it receives
+exactly the calls parse_dbc() makes, on the calling thread.
+
+A chunk may start inside a string or comment spanning lines. The chunk before it
+then doesn't parse to its end, and the list is parsed again in one piece, as is a
+list that fails to parse, which reports the same syntax error parse_dbc() does.
+
+parse_dbcs() and parse_dbc_files() parse many DBCs concurrently, each one on a
+single thread, into their own interpreters.
+
+*/
+
+namespace can {
+
+struct dbc_parse_options {
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t min_chunk_size = 64 * 1024; // lists shorter than two chunks are parsed in one piece
+	dbc_sections sections = dbc_sections::all; // see parse_dbc(dbc_src, ipt, sections)
+};
+
+bool parse_dbc_parallel(std::string_view dbc_src, interpreter ipt, const dbc_parse_options& opts = {});
+
+// Parses dbc_srcs[i] into ipts[i], for as many DBCs as there are interpreters.
+// Returns which DBCs parsed successfully.
+std::vector<bool> parse_dbcs(
+	std::span<const std::string_view> dbc_srcs, std::span<interpreter> ipts, const dbc_parse_options& opts = {}
+);
+
+// Same as parse_dbcs(), mapping the files on the worker threads. Unreadable files fail to parse.
+std::vector<bool> parse_dbc_files(
+	std::span<const std::filesystem::path> paths, std::span<interpreter> ipts, const dbc_parse_options& opts = {}
+);
+
+} // end namespace can
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <span>
 #include <optional>
+#include <type_traits>
 #include <string_view>
 #include <string>
 #include <vector>
@@ -16,23 +18,84 @@ struct method_name {
 	constexpr method_name(const char(&d)[N]) {}
 };
 
+// Result of the default (no-op) tag_invokes; tells the callbacks an interpreter implements from the ones it doesn't.
+struct unhandled {};
+
 template <method_name method, typename ...Args>
 struct cpo {
 	using type_erased_signature_t = void (mireo::this_&, Args...);
 
+	template <typename T>
+	static constexpr bool handled_by = !std::is_same_v<mireo::tag_invoke_result_t<cpo, T&, Args...>, unhandled>;
+
 	template <typename T>
 	requires mireo::tag_invocable<cpo, T&, Args...>
 	void operator()(T& x, Args ...args) const {
-		return mireo::tag_invoke(*this, x, std::forward<Args>(args)...);
+		mireo::tag_invoke(*this, x, std::forward<Args>(args)...);
+	}
+
+	template <typename T>
+	friend decltype(auto) tag_invoke(cpo<method, Args...>, std::reference_wrapper<T>& t, Args... args) {
+		return mireo::tag_invoke(cpo<method, Args...>{}, t.get(), std::forward<Args>(args)...);
+	}
+
+	template <typename T>
+	friend unhandled tag_invoke(cpo<method, Args...>, T&, Args...) { return {}; }
+};
+
+inline std::string owned(std::string_view v) { return std::string(v); }
+
+template <typename T>
+requires std::is_trivially_copyable_v<T>
+T owned(T v) { return v; }
+
+template <typename A, typename B>
+auto owned(const std::pair<A, B>& v) {
+	return std::make_pair(owned(v.first), owned(v.second));
+}
+
+template <typename T>
+auto owned(std::span<const T> v) {
+	std::vector<decltype(owned(std::declval<const T&>()))> rv;
+	rv.reserve(v.size());
+	for (const auto& e : v)
+		rv.push_back(owned(e));
+	return rv;
+}
+
+inline std::variant<int32_t, double, std::string> owned(const std::variant<int32_t, double, std::string_view>& v) {
+	return std::visit([](auto e) { return std::variant<int32_t, double, std::string>(owned(e)); }, v);
+}
+
+// Callback with views into the DBC source (or into parser-owned scratch storage) instead of
+// strings and vectors; the views are valid only during the call. Interpreters that implement
+// just the owning callback get owning copies of the arguments, others nothing at all.
+template <method_name method, typename OwningCpo, typename ...Args>
+struct view_cpo {
+	using type_erased_signature_t = void (mireo::this_&, Args...);
+
+	template <typename T>
+	static constexpr bool handled_by =
+		!std::is_same_v<mireo::tag_invoke_result_t<view_cpo, T&, Args...>, unhandled>;
+
+	template <typename T>
+	requires mireo::tag_invocable<view_cpo, T&, Args...>
+	void operator()(T& x, Args ...args) const {
+		mireo::tag_invoke(*this, x, args...);
 	}
 
 	template <typename T>
-	friend void tag_invoke(cpo<method, Args...>, std::reference_wrapper<T>& t, Args... args) {
-		mireo::tag_invoke(cpo<method, Args...>{}, t.get(), std::forward<Args>(args)...);
+	friend decltype(auto) tag_invoke(view_cpo, std::reference_wrapper<T>& t, Args... args) {
+		return mireo::tag_invoke(view_cpo{}, t.get(), args...);
 	}
 
 	template <typename T>
-	friend void tag_invoke(cpo<method, Args...>, T&, Args...) {}
+	friend auto tag_invoke(view_cpo, T& t, Args... args) {
+		if constexpr (OwningCpo::template handled_by<T>)
+			OwningCpo{}(t, owned(args)...);
+		else
+			return unhandled{};
+	}
 };
 
 using def_version_cpo = cpo<"version", std::string>;
@@ -139,36 +202,223 @@ inline constexpr def_bo_tx_bu_cpo def_bo_tx_bu;
 using def_sg_mul_val_cpo = cpo<"sg_mul_val", unsigned, std::string, std::string, std::vector<std::pair<unsigned, unsigned>>>;
 inline constexpr def_sg_mul_val_cpo def_sg_mul_val;
 
+// Not a DBC statement: the number of BO_ messages and SG_ signals, counted before parsing them,
+// so interpreters can reserve for them. It's only a hint, statements in comments count too.
+using def_counts_cpo = cpo<"counts", size_t, size_t>;
+inline constexpr def_counts_cpo def_counts;
+
+using attr_value_view = std::variant<int32_t, double, std::string_view>;
+using val_desc_view = std::pair<unsigned, std::string_view>;
+
+using def_version_view_cpo = view_cpo<"version_view", def_version_cpo, std::string_view>;
+inline constexpr def_version_view_cpo def_version_view;
+
+using def_bu_view_cpo = view_cpo<"bu_view", def_bu_cpo, std::span<const std::string_view>>;
+inline constexpr def_bu_view_cpo def_bu_view;
+
+using def_bo_view_cpo = view_cpo<"bo_view", def_bo_cpo, uint32_t, std::string_view, size_t, size_t>;
+inline constexpr def_bo_view_cpo def_bo_view;
+
+using def_sg_view_cpo = view_cpo<
+	"sg_view", def_sg_cpo, uint32_t, std::optional<unsigned>, std::string_view,
+	unsigned, unsigned, char, char, double, double, double, double,
+	std::string_view, std::span<const size_t>
+>;
+inline constexpr def_sg_view_cpo def_sg_view;
+
+using def_sg_mux_view_cpo = view_cpo<
+	"sg_mux_view", def_sg_mux_cpo, uint32_t, std::string_view,
+	unsigned, unsigned, char, char,
+	std::string_view, std::span<const size_t>
+>;
+inline constexpr def_sg_mux_view_cpo def_sg_mux_view;
+
+using def_ev_view_cpo = view_cpo<
+	"ev_view", def_ev_cpo, std::string_view, unsigned, double, double,
+	std::string_view, double, unsigned, std::string_view, std::span<const size_t>
+>;
+inline constexpr def_ev_view_cpo def_ev_view;
+
+using def_envvar_data_view_cpo = view_cpo<"envvar_data_view", def_envvar_data_cpo, std::string_view, unsigned>;
+inline constexpr def_envvar_data_view_cpo def_envvar_data_view;
+
+using def_sgtype_ref_view_cpo = view_cpo<"sgtype_ref_view", def_sgtype_ref_cpo, unsigned, std::string_view, std::string_view>;
+inline constexpr def_sgtype_ref_view_cpo def_sgtype_ref_view;
+
+using def_sgtype_view_cpo = view_cpo<
+	"sgtype_view", def_sgtype_cpo, std::string_view, unsigned, char, char,
+	double, double, double, double, std::string_view, double, size_t
+>;
+inline constexpr def_sgtype_view_cpo def_sgtype_view;
+
+using def_sig_group_view_cpo = view_cpo<
+	"sig_group_view", def_sig_group_cpo, unsigned, std::string_view, unsigned, std::span<const std::string_view>
+>;
+inline constexpr def_sig_group_view_cpo def_sig_group_view;
+
+using def_cm_glob_view_cpo = view_cpo<"cm_view", def_cm_glob_cpo, std::string_view>;
+inline constexpr def_cm_glob_view_cpo def_cm_glob_view;
+
+using def_cm_bu_view_cpo = view_cpo<"cm_msg_view", def_cm_bu_cpo, unsigned, std::string_view>;
+inline constexpr def_cm_bu_view_cpo def_cm_bu_view;
+
+using def_cm_bo_view_cpo = view_cpo<"cm_bo_view", def_cm_bo_cpo, uint32_t, std::string_view>;
+inline constexpr def_cm_bo_view_cpo def_cm_bo_view;
+
+using def_cm_sg_view_cpo = view_cpo<"cm_sg_view", def_cm_sg_cpo, uint32_t, std::string_view, std::string_view>;
+inline constexpr def_cm_sg_view_cpo def_cm_sg_view;
+
+using def_cm_ev_view_cpo = view_cpo<"cm_ev_view", def_cm_ev_cpo, std::string_view, std::string_view>;
+inline constexpr def_cm_ev_view_cpo def_cm_ev_view;
+
+using def_ba_def_enum_view_cpo = view_cpo<
+	"ba_def_enum_view", def_ba_def_enum_cpo, std::string_view, std::string_view, std::span<const std::string_view>
+>;
+inline constexpr def_ba_def_enum_view_cpo def_ba_def_enum_view;
+
+using def_ba_def_int_view_cpo = view_cpo<"ba_def_int_view", def_ba_def_int_cpo, std::string_view, std::string_view, int32_t, int32_t>;
+inline constexpr def_ba_def_int_view_cpo def_ba_def_int_view;
+
+using def_ba_def_float_view_cpo = view_cpo<"ba_def_float_view", def_ba_def_float_cpo, std::string_view, std::string_view, double, double>;
+inline constexpr def_ba_def_float_view_cpo def_ba_def_float_view;
+
+using def_ba_def_string_view_cpo = view_cpo<"ba_def_string_view", def_ba_def_string_cpo, std::string_view, std::string_view>;
+inline constexpr def_ba_def_string_view_cpo def_ba_def_string_view;
+
+using def_ba_def_def_view_cpo = view_cpo<"ba_def_def_view", def_ba_def_def_cpo, std::string_view, attr_value_view>;
+inline constexpr def_ba_def_def_view_cpo def_ba_def_def_view;
+
+using def_ba_view_cpo = view_cpo<
+	"ba_view", def_ba_cpo, std::string_view, std::string_view, std::string_view, size_t, unsigned,
+	attr_value_view
+>;
+inline constexpr def_ba_view_cpo def_ba_view;
+
+using def_val_env_view_cpo = view_cpo<"val_env_view", def_val_env_cpo, std::string_view, std::span<const val_desc_view>>;
+inline constexpr def_val_env_view_cpo def_val_env_view;
+
+using def_val_sg_view_cpo = view_cpo<
+	"val_sg_view", def_val_sg_cpo, uint32_t, std::string_view, std::span<const val_desc_view>
+>;
+inline constexpr def_val_sg_view_cpo def_val_sg_view;
+
+using def_val_table_view_cpo = view_cpo<"val_table_view", def_val_table_cpo, std::string_view, std::span<const val_desc_view>>;
+inline constexpr def_val_table_view_cpo def_val_table_view;
+
+using def_sig_valtype_view_cpo = view_cpo<"sig_valtype_view", def_sig_valtype_cpo, unsigned, std::string_view, unsigned>;
+inline constexpr def_sig_valtype_view_cpo def_sig_valtype_view;
+
+using def_bo_tx_bu_view_cpo = view_cpo<"bo_tx_bu_view", def_bo_tx_bu_cpo, unsigned, std::span<const std::string_view>>;
+inline constexpr def_bo_tx_bu_view_cpo def_bo_tx_bu_view;
+
+using def_sg_mul_val_view_cpo = view_cpo<
+	"sg_mul_val_view", def_sg_mul_val_cpo, unsigned, std::string_view, std::string_view,
+	std::span<const std::pair<unsigned, unsigned>>
+>;
+inline constexpr def_sg_mul_val_view_cpo def_sg_mul_val_view;
+
+using def_counts_view_cpo = view_cpo<"counts_view", def_counts_cpo, size_t, size_t>;
+inline constexpr def_counts_view_cpo def_counts_view;
+
+// DBC sections, as a set of the ones an interpreter consumes. VERSION, NS_, BS_ and BU_ are always parsed.
+enum class dbc_sections : uint32_t {
+	none = 0,
+	val_table = 1 << 0,
+	bo = 1 << 1,            // BO_ messages
+	sg = 1 << 2,            // SG_ signals of the messages
+	bo_tx_bu = 1 << 3,
+	ev = 1 << 4,
+	envvar_data = 1 << 5,
+	val = 1 << 6,
+	sgtype = 1 << 7,
+	sig_group = 1 << 8,
+	cm = 1 << 9,
+	ba_def = 1 << 10,
+	ba_def_def = 1 << 11,
+	ba = 1 << 12,
+	sig_valtype = 1 << 13,
+	sg_mul_val = 1 << 14,
+	counts = 1 << 15,       // the def_counts hint, made only when the whole DBC is at hand
+	all = (1 << 16) - 1
+};
+
+constexpr dbc_sections operator|(dbc_sections a, dbc_sections b) {
+	return dbc_sections(uint32_t(a) | uint32_t(b));
+}
+
+constexpr dbc_sections operator&(dbc_sections a, dbc_sections b) {
+	return dbc_sections(uint32_t(a) & uint32_t(b));
+}
+
+constexpr dbc_sections operator~(dbc_sections a) {
+	return dbc_sections(~uint32_t(a) & uint32_t(dbc_sections::all));
+}
+
+constexpr bool contains(dbc_sections set, dbc_sections s) {
+	return (set & s) != dbc_sections::none;
+}
+
+// Sections with at least one callback (view or owning) implemented by T.
+template <typename T>
+inline constexpr dbc_sections handled_sections = [] {
+	auto handled = []<typename ...Cpos>(dbc_sections s, Cpos...) {
+		return (Cpos::template handled_by<T> || ...) ? s : dbc_sections::none;
+	};
+	return handled(dbc_sections::val_table, def_val_table_view) |
+		handled(dbc_sections::bo, def_bo_view) |
+		handled(dbc_sections::sg, def_sg_view, def_sg_mux_view) |
+		handled(dbc_sections::bo_tx_bu, def_bo_tx_bu_view) |
+		handled(dbc_sections::ev, def_ev_view) |
+		handled(dbc_sections::envvar_data, def_envvar_data_view) |
+		handled(dbc_sections::val, def_val_env_view, def_val_sg_view) |
+		handled(dbc_sections::sgtype, def_sgtype_view, def_sgtype_ref_view) |
+		handled(dbc_sections::sig_group, def_sig_group_view) |
+		handled(dbc_sections::cm, def_cm_glob_view, def_cm_bu_view, def_cm_bo_view, def_cm_sg_view, def_cm_ev_view) |
+		handled(dbc_sections::ba_def, def_ba_def_enum_view, def_ba_def_int_view, def_ba_def_float_view, def_ba_def_string_view) |
+		handled(dbc_sections::ba_def_def, def_ba_def_def_view) |
+		handled(dbc_sections::ba, def_ba_view) |
+		handled(dbc_sections::sig_valtype, def_sig_valtype_view) |
+		handled(dbc_sections::sg_mul_val, def_sg_mul_val_view) |
+		handled(dbc_sections::counts, def_counts_view);
+}();
+
+// The parser makes only the view callbacks; they fall back to the owning ones per interpreter type.
 using interpreter = mireo::any<
-	def_version,
-	def_bu,
-	def_bo,
-	def_ev,
-	def_envvar_data,
-	def_sgtype,
-	def_sgtype_ref,
-	def_sig_group,
-	def_cm_glob,
-	def_cm_bu,
-	def_cm_bo,
-	def_cm_sg,
-	def_cm_ev,
-	def_ba_def_enum,
-	def_ba_def_int,
-	def_ba_def_float,
-	def_ba_def_string,
-	def_ba_def_def,
-	def_ba,
-	def_sg,
-	def_sg_mux,
-	def_val_env,
-	def_val_sg,
-	def_val_table,
-	def_sig_valtype,
-	def_bo_tx_bu,
-	def_sg_mul_val
+	def_version_view,
+	def_bu_view,
+	def_bo_view,
+	def_ev_view,
+	def_envvar_data_view,
+	def_sgtype_view,
+	def_sgtype_ref_view,
+	def_sig_group_view,
+	def_cm_glob_view,
+	def_cm_bu_view,
+	def_cm_bo_view,
+	def_cm_sg_view,
+	def_cm_ev_view,
+	def_ba_def_enum_view,
+	def_ba_def_int_view,
+	def_ba_def_float_view,
+	def_ba_def_string_view,
+	def_ba_def_def_view,
+	def_ba_view,
+	def_sg_view,
+	def_sg_mux_view,
+	def_val_env_view,
+	def_val_sg_view,
+	def_val_table_view,
+	def_sig_valtype_view,
+	def_bo_tx_bu_view,
+	def_sg_mul_val_view,
+	def_counts_view
 >;
 
 bool parse_dbc(std::string_view dbc_src, interpreter ipt);
 
+// Parses only `sections` (and the ones they depend on) with the grammar. The other sections
+// are skipped with a coarse check: statements start with the section's keyword, close their
+// strings and end with ';' where the grammar requires it.
+bool parse_dbc(std::string_view dbc_src, interpreter ipt, dbc_sections sections);
+
 } // end namespace can
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+/*
+
+Vectorized scanning primitives of the DBC grammar: whitespace runs, line ends,
+comment ends, identifier and quoted-string extents.
+
+Blocks of 16 bytes are compared at once with SSE2 on x86-64 and NEON on ARM64,
+both part of the baseline instruction set, so no runtime dispatch is needed.
+Shorter tails, and other targets, use the scalar loops. Define DBC_SCAN_SCALAR
+to use the scalar loops everywhere.
+
+*/
+
+#if !defined(DBC_SCAN_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define DBC_SCAN_SSE2
+#include <emmintrin.h>
+#elif !defined(DBC_SCAN_SCALAR) && (defined(__ARM_NEON) || defined(_M_ARM64))
+#define DBC_SCAN_NEON
+#include <arm_neon.h>
+#endif
+
+namespace can::dbc_scan {
+
+inline bool is_name_char(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+namespace detail {
+
+#if defined(DBC_SCAN_SSE2)
+
+using vec = __m128i;
+constexpr int mask_shift = 0; // one mask bit per byte
+
+inline vec load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline vec eq(vec v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+inline vec either(vec a, vec b) { return _mm_or_si128(a, b); }
+inline vec negate(vec a) { return _mm_xor_si128(a, _mm_set1_epi8(-1)); }
+
+// bytes in [lo, hi], as an unsigned comparison of v - lo
+inline vec in_range(vec v, char lo, char hi) {
+	vec t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+	return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(char(hi - lo))), t);
+}
+
+inline uint64_t to_mask(vec m) { return uint32_t(_mm_movemask_epi8(m)); }
+
+#elif defined(DBC_SCAN_NEON)
+
+using vec = uint8x16_t;
+constexpr int mask_shift = 2; // four mask bits per byte
+
+inline vec load(const char* p) { return vld1q_u8(reinterpret_cast<const uint8_t*>(p)); }
+inline vec eq(vec v, char c) { return vceqq_u8(v, vdupq_n_u8(uint8_t(c))); }
+inline vec either(vec a, vec b) { return vorrq_u8(a, b); }
+inline vec negate(vec a) { return vmvnq_u8(a); }
+
+inline vec in_range(vec v, char lo, char hi) {
+	return vcleq_u8(vsubq_u8(v, vdupq_n_u8(uint8_t(lo))), vdupq_n_u8(uint8_t(hi - lo)));
+}
+
+inline uint64_t to_mask(vec m) {
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+
+#endif
+
+// First p in [p, e) with pred(*p). `block(v)` marks the matching bytes of 16 bytes at once.
+// Most runs between tokens are short, so the first byte is checked before loading a block.
+template <typename Block, typename Pred>
+const char* find_if(const char* p, const char* e, Block&& block, Pred&& pred) {
+	if (p == e || pred(*p))
+		return p;
+#if defined(DBC_SCAN_SSE2) || defined(DBC_SCAN_NEON)
+	for (; e - p >= 16; p += 16) {
+		if (uint64_t m = to_mask(block(load(p))))
+			return p + (std::countr_zero(m) >> mask_shift);
+	}
+#endif
+	while (p != e && !pred(*p))
+		++p;
+	return p;
+}
+
+#if defined(DBC_SCAN_SSE2) || defined(DBC_SCAN_NEON)
+template <char C, char ...Cs>
+vec any_of(vec v) {
+	if constexpr (sizeof...(Cs) == 0)
+		return eq(v, C);
+	else
+		return either(eq(v, C), any_of<Cs...>(v));
+}
+#endif
+
+} // end namespace detail
+
+// first character in [p, e) that is one of Cs, or e
+template <char ...Cs>
+const char* find_first_of(const char* p, const char* e) {
+	return detail::find_if(p, e,
+#if defined(DBC_SCAN_SSE2) || defined(DBC_SCAN_NEON)
+		[](detail::vec v) { return detail::any_of<Cs...>(v); },
+#else
+		nullptr,
+#endif
+		[](char c) { return ((c == Cs) || ...); }
+	);
+}
+
+// first character in [p, e) that is none of Cs, or e
+template <char ...Cs>
+const char* find_first_not_of(const char* p, const char* e) {
+	return detail::find_if(p, e,
+#if defined(DBC_SCAN_SSE2) || defined(DBC_SCAN_NEON)
+		[](detail::vec v) { return detail::negate(detail::any_of<Cs...>(v)); },
+#else
+		nullptr,
+#endif
+		[](char c) { return ((c != Cs) && ...); }
+	);
+}
+
+// first character that isn't a space or a tab
+inline const char* skip_blanks(const char* p, const char* e) {
+	return find_first_not_of<' ', '\t'>(p, e);
+}
+
+inline const char* find_eol(const char* p, const char* e) {
+	auto eol = static_cast<const char*>(std::memchr(p, '\n', e - p));
+	return eol ? eol : e;
+}
+
+// end of an identifier's [A-Za-z0-9_] characters
+inline const char* skip_name(const char* p, const char* e) {
+	return detail::find_if(p, e,
+#if defined(DBC_SCAN_SSE2) || defined(DBC_SCAN_NEON)
+		[](detail::vec v) {
+			using namespace detail;
+			vec name = either(
+				either(in_range(v, 'a', 'z'), in_range(v, 'A', 'Z')),
+				either(in_range(v, '0', '9'), eq(v, '_'))
+			);
+			return negate(name);
+		},
+#else
+		nullptr,
+#endif
+		[](char c) { return !is_name_char(c); }
+	);
+}
+
+// closing '"' of a quoted string whose body starts at p, over \\ and \" escapes, or e if it isn't closed.
+// `escaped` is set if the body has escapes.
+inline const char* find_quote_end(const char* p, const char* e, bool& escaped) {
+	escaped = false;
+	while ((p = find_first_of<'"', '\\'>(p, e)) != e && *p == '\\') {
+		if (p + 1 != e && (p[1] == '\\' || p[1] == '"')) {
+			escaped = true;
+			p += 2;
+		}
+		else
+			++p;
+	}
+	return p;
+}
+
+// past the "*/" that closes a block comment whose body starts at p, or nullptr if it isn't closed
+inline const char* find_comment_end(const char* p, const char* e) {
+	while (true) {
+		auto star = static_cast<const char*>(std::memchr(p, '*', e - p));
+		if (!star || e - star < 2)
+			return nullptr;
+		if (star[1] == '/')
+			return star + 2;
+		p = star + 1;
+	}
+}
+
+} // end namespace can::dbc_scan
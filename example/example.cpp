@@ -1,19 +1,14 @@
 #include <iostream>
 #include <iomanip>
-#include <fstream>
 #include <chrono>
 #include <random>
 #include <bit>
 
-#include "dbc/dbc_parser.h"
+#include "dbc/dbc_grammar.h"
+#include "dbc/dbc_file.h"
 #include "v2c/v2c_transcoder.h"
-
-std::string read_file(const std::string& dbc_path) {
-	std::ifstream dbc_content(dbc_path);
-	std::ostringstream ss;
-	ss << dbc_content.rdbuf();
-	return ss.str();
-}
+#include "v2c/v2c_replay.h"
+#include "can/log_reader.h"
 
 can_frame generate_frame() {
 	static std::default_random_engine generator; 
@@ -45,12 +40,35 @@ void print_frames(const can::frame_packet& fp, can::v2c_transcoder& transcoder,
 	}
 }
 
-int main() {
+// Replays a candump -L trace through the transcoder and prints the replay statistics.
+int replay_trace(const char* trace_path, can::v2c_transcoder& transcoder) {
+	can::v2c_replay replay(transcoder, [](can::frame_packet&&) {});
+
+	auto rs = can::read_candump(std::filesystem::path(trace_path), [&](std::span<const can::timed_frame> frames) {
+		replay.feed(frames);
+	});
+	replay.finish();
+
+	auto st = replay.stats();
+	std::cout << "Replayed " << st.frames << " frames (" << rs.skipped << " lines skipped) in "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(st.wall_time).count() << "ms: "
+		<< st.frames_per_sec() << " frames/s, " << st.packets << " packets, " << st.bytes_out << " bytes out, "
+		<< "digest " << std::hex << st.digest << std::dec << std::endl;
+	std::cout << can::to_json(transcoder.metrics_snapshot()) << std::endl;
+
+	return 0;
+}
+
+int main(int argc, char** argv) {
 	can::v2c_transcoder transcoder;
 
 	auto start = std::chrono::system_clock::now();
 
-	bool parsed = can::parse_dbc(read_file("example/example.dbc"), std::ref(transcoder));
+	// parsed in place from the mapped file
+	can::dbc_file dbc("example/example.dbc");
+	bool parsed = dbc.valid() && can::parse_dbc(
+		dbc.text(), transcoder, can::handled_sections<can::v2c_transcoder>
+	);
 	if (!parsed)
 		return 1;
 
@@ -58,6 +76,9 @@ int main() {
 
 	std::cout << "Parsed DBC in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
 
+	if (argc > 1)
+		return replay_trace(argv[1], transcoder);
+
 	int32_t frame_counter = 0;
 
 	while (true) {
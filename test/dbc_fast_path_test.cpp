@@ -0,0 +1,321 @@
+/*
+	Fuzz-equivalence test of the BO_/SG_ fast path against the grammar.
+
+	Generates random DBCs, mostly canonical BO_ and SG_ lines, with the variations the
+	fast path must leave to the grammar or parse the same way: odd blanks, comments
+	inside and after statements, statements split over lines, CRLF line ends, extended
+	multiplexing, numbers in every notation x3 accepts, unknown nodes, node names that
+	prefix others, and a few corrupted characters. Every callback the parser makes is
+	recorded, with the result of parse_dbc().
+
+	Build it once as is and once with -DDBC_NO_FAST_PATH, and compare the outputs, as
+	dbc_fast_path_test.sh does:
+
+		dbc_fast_path_test [count [first_seed]]    one line per DBC: seed, result, calls, hash of the calls
+		dbc_fast_path_test --dump seed             the DBC and its calls
+*/
+
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <variant>
+#include <optional>
+
+#include "dbc/dbc_parser.h"
+
+class recorder {
+	std::string _log;
+	size_t _calls = 0;
+
+	void put(const std::string& s) { _log += '"'; _log += s; _log += '"'; }
+	void put(char c) { _log += c; }
+	void put(double d) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%.17g", d);
+		_log += buf;
+	}
+	template <typename T>
+	requires std::is_integral_v<T>
+	void put(T v) { _log += std::to_string(v); }
+	template <typename T>
+	void put(const std::optional<T>& v) {
+		if (v)
+			put(*v);
+		else
+			_log += "-";
+	}
+	template <typename A, typename B>
+	void put(const std::pair<A, B>& v) {
+		put(v.first);
+		_log += '=';
+		put(v.second);
+	}
+	template <typename T>
+	void put(const std::vector<T>& v) {
+		_log += '[';
+		for (const auto& e : v) {
+			put(e);
+			_log += ',';
+		}
+		_log += ']';
+	}
+	template <typename... Ts>
+	void put(const std::variant<Ts...>& v) {
+		std::visit([this](const auto& e) { put(e); }, v);
+	}
+
+	template <typename... Args>
+	void record(const char* what, const Args&... args) {
+		++_calls;
+		_log += what;
+		((_log += ' ', put(args)), ...);
+		_log += '\n';
+	}
+
+public:
+	const std::string& log() const { return _log; }
+	size_t calls() const { return _calls; }
+
+	friend void tag_invoke(can::def_version_cpo, recorder& r, std::string version) {
+		r.record("VERSION", version);
+	}
+	friend void tag_invoke(can::def_bu_cpo, recorder& r, std::vector<std::string> nodes) {
+		r.record("BU_", nodes);
+	}
+	friend void tag_invoke(can::def_bo_cpo, recorder& r, uint32_t id, std::string name, size_t size, size_t transmitter) {
+		r.record("BO_", id, name, size, transmitter);
+	}
+	friend void tag_invoke(
+		can::def_sg_cpo, recorder& r, uint32_t id, std::optional<unsigned> mux_val, std::string name,
+		unsigned start_bit, unsigned size, char byte_order, char sign, double factor, double offset,
+		double min, double max, std::string unit, std::vector<size_t> receivers
+	) {
+		r.record("SG_", id, mux_val, name, start_bit, size, byte_order, sign, factor, offset, min, max, unit, receivers);
+	}
+	friend void tag_invoke(
+		can::def_sg_mux_cpo, recorder& r, uint32_t id, std::string name,
+		unsigned start_bit, unsigned size, char byte_order, char sign, std::string unit, std::vector<size_t> receivers
+	) {
+		r.record("SG_MUX", id, name, start_bit, size, byte_order, sign, unit, receivers);
+	}
+	friend void tag_invoke(can::def_bo_tx_bu_cpo, recorder& r, unsigned id, std::vector<std::string> nodes) {
+		r.record("BO_TX_BU_", id, nodes);
+	}
+	friend void tag_invoke(can::def_cm_bo_cpo, recorder& r, uint32_t id, std::string text) {
+		r.record("CM_BO", id, text);
+	}
+	friend void tag_invoke(can::def_cm_sg_cpo, recorder& r, uint32_t id, std::string sig, std::string text) {
+		r.record("CM_SG", id, sig, text);
+	}
+	friend void tag_invoke(can::def_ba_def_string_cpo, recorder& r, std::string type, std::string name) {
+		r.record("BA_DEF_", type, name);
+	}
+	friend void tag_invoke(
+		can::def_ba_cpo, recorder& r, std::string name, std::string type, std::string object,
+		size_t id, unsigned ord, std::variant<int32_t, double, std::string> value
+	) {
+		r.record("BA_", name, type, object, id, ord, value);
+	}
+	friend void tag_invoke(can::def_val_sg_cpo, recorder& r, uint32_t id, std::string sig, std::vector<std::pair<unsigned, std::string>> vals) {
+		r.record("VAL_", id, sig, vals);
+	}
+	friend void tag_invoke(can::def_sig_valtype_cpo, recorder& r, unsigned id, std::string sig, unsigned type) {
+		r.record("SIG_VALTYPE_", id, sig, type);
+	}
+	friend void tag_invoke(
+		can::def_sg_mul_val_cpo, recorder& r, unsigned id, std::string sig, std::string switch_sig,
+		std::vector<std::pair<unsigned, unsigned>> ranges
+	) {
+		r.record("SG_MUL_VAL_", id, sig, switch_sig, ranges);
+	}
+};
+
+class dbc_generator {
+	std::mt19937_64 _rng;
+	std::string _dbc;
+
+	static constexpr const char* nodes[] = { "ECU", "ECU12", "GW", "Vector__XXX", "V2C" };
+
+	bool chance(unsigned percent) { return _rng() % 100 < percent; }
+	// for the variations that fail a whole DBC, which then tests nothing after them
+	bool rarely() { return _rng() % 1000 == 0; }
+	template <typename T, size_t N>
+	const T& pick(const T (&a)[N]) { return a[_rng() % N]; }
+
+	// between tokens: usually one space, sometimes nothing, more blanks or a block comment
+	std::string gap(bool required) {
+		if (chance(85))
+			return " ";
+		static constexpr const char* gaps[] = { "  ", "\t", " \t ", "", " /* c */ ", "/**/" };
+		std::string g = pick(gaps);
+		// after a keyword, or between two numbers or names, a blank is required
+		return required && (g.empty() || g[0] == '/') ? " " + g : g;
+	}
+
+	std::string eol() {
+		static constexpr const char* eols[] = { "\n", "\n", "\n", "\r\n", " \n", "\t\n", " // note\n", "\n\n" };
+		return chance(80) ? "\n" : pick(eols);
+	}
+
+	std::string name(const char* prefix) {
+		static constexpr const char* firsts[] = { "S", "Mode", "mux", "M", "m1", "_x", "Vin", "a" };
+		std::string rv = chance(70) ? prefix : pick(firsts);
+		rv += std::to_string(_rng() % 100);
+		if (rarely())
+			rv = "9" + rv;
+		return rv;
+	}
+
+	std::string uint() {
+		if (chance(90))
+			return std::to_string(_rng() % 2048);
+		static constexpr const char* big[] = { "123456789", "1234567890", "4294967295", "4294967296", "99999999999", "0000012", "-1" };
+		return pick(big);
+	}
+
+	// a factor that's 0 within epsilon fails the DBC, like a malformed number
+	std::string real(bool factor = false) {
+		static constexpr const char* reals[] = {
+			"1", "0.5", "-1", "-0.25", ".5", "5.", "1e3", "1.5E-2", "+2", "3.40282347e+38",
+			"100", "-40", "0.000001", "1.", "-.5", "12345678901234567890", "1E+2"
+		};
+		static constexpr const char* zeros[] = { "-0", "-1e-300", "0.0", "1e-20" };
+		static constexpr const char* bad_reals[] = { "0", "1e400", "0x10", "2e", "1,5", "+-1", "e5", "." };
+		if (rarely())
+			return pick(bad_reals);
+		if (!factor && chance(5))
+			return pick(zeros);
+		return chance(60) ? std::to_string(1 + _rng() % 1000) + (chance(50) ? "" : ".25") : pick(reals);
+	}
+
+	std::string node() {
+		if (rarely())
+			return "Unknown" + std::to_string(_rng() % 3);
+		return pick(nodes);
+	}
+
+	std::string unit() {
+		static constexpr const char* units[] = { "", "km/h", "1/s", "99kph", "%", "deg C", "\\\"in\\\"", "a;b" };
+		return std::string("\"") + pick(units) + "\"";
+	}
+
+	// corrupts a character of the statement now and then
+	std::string mangle(std::string s) {
+		if (!rarely() || s.empty())
+			return s;
+		static constexpr char junk[] = { ':', '|', '@', '(', ')', '[', ']', ',', '"', ' ', '\n', 'M', 'm', '1', '/' };
+		size_t at = _rng() % s.size();
+		switch (_rng() % 3) {
+			case 0: s.erase(at, 1); break;
+			case 1: s.insert(s.begin() + at, pick(junk)); break;
+			default: s[at] = pick(junk); break;
+		}
+		return s;
+	}
+
+	std::string bo_line(unsigned id, const std::string& msg) {
+		std::string s = "BO_" + gap(true) + std::to_string(id) + gap(true) + msg + gap(false) + ":" + gap(false) +
+			(chance(99) ? std::to_string(_rng() % 9) : uint()) + gap(true) + node();
+		return mangle(s) + eol();
+	}
+
+	std::string sg_line(const std::string& sig) {
+		std::string mux;
+		switch (_rng() % 10) {
+			case 0: mux = gap(true) + "M"; break;
+			case 1: mux = gap(true) + "m" + std::to_string(_rng() % 4); break;
+			case 2: mux = gap(true) + "m" + std::to_string(_rng() % 4) + "M"; break;
+			case 3: mux = gap(true) + "m" + gap(true) + "2"; break;
+			default: break;
+		}
+		std::string receivers = node();
+		for (unsigned i = _rng() % 3; i > 0; --i)
+			receivers += gap(false) + "," + gap(false) + node();
+
+		static constexpr const char* indents[] = { "", "\t", "  ", "\n " };
+		static constexpr const char* unit_gaps[] = { "", "\t", "  " };
+		std::string s = std::string(chance(80) ? " " : pick(indents)) + "SG_" + gap(true) + sig + mux +
+			gap(true) + ":" + gap(false) + std::to_string(_rng() % 64) + gap(false) + "|" + gap(false) +
+			std::to_string(1 + _rng() % 64) + gap(false) + "@" + gap(false) + (chance(50) ? "1" : "0") + gap(false) +
+			(chance(50) ? "+" : "-") + gap(false) + "(" + gap(false) + real(true) + gap(false) + "," + gap(false) + real() +
+			gap(false) + ")" + gap(false) + "[" + real() + "|" + real() + "]" + gap(false) + unit() +
+			(chance(90) ? " " : rarely() ? "\n " : pick(unit_gaps)) + receivers;
+		return mangle(s) + eol();
+	}
+
+public:
+	explicit dbc_generator(uint64_t seed) : _rng(seed) {}
+
+	std::string operator()() {
+		_dbc = "VERSION \"fuzz\"\n\nNS_ :\n\tCM_\n\tBA_DEF_\n\tBA_\n\tVAL_\n\nBS_:\n\nBU_:";
+		for (const char* n : nodes)
+			_dbc += std::string(" ") + n;
+		_dbc += "\n\n";
+
+		struct sig_ref { unsigned id; std::string name; };
+		std::vector<sig_ref> sigs;
+		std::vector<unsigned> ids;
+		for (unsigned m = 1 + _rng() % 6; m > 0; --m) {
+			unsigned id = unsigned(chance(90) ? _rng() % 2048 : 0x80000000u | (_rng() % 0x1fffffff));
+			ids.push_back(id);
+			_dbc += bo_line(id, name("Msg"));
+			for (unsigned s = _rng() % 7; s > 0; --s) {
+				auto sig = name("Sig");
+				sigs.push_back({ id, sig });
+				_dbc += sg_line(sig);
+			}
+			if (chance(70))
+				_dbc += eol();
+		}
+
+		// the statements after the messages check that the fast path ends them where the grammar does
+		if (!ids.empty() && chance(50))
+			_dbc += "BO_TX_BU_ " + std::to_string(ids[0]) + " : ECU,GW;\n\n";
+		for (const auto& s : sigs)
+			if (chance(30))
+				_dbc += "CM_ SG_ " + std::to_string(s.id) + " " + s.name + " \"about " + s.name + "\";\n";
+		if (!ids.empty())
+			_dbc += "CM_ BO_ " + std::to_string(ids.back()) + " \"last message\";\n";
+		_dbc += "BA_DEF_ SG_ \"AggType\" STRING ;\n";
+		for (const auto& s : sigs)
+			if (chance(30))
+				_dbc += "BA_ \"AggType\" SG_ " + std::to_string(s.id) + " " + s.name + " \"AVG\";\n";
+		for (const auto& s : sigs)
+			if (chance(20))
+				_dbc += "VAL_ " + std::to_string(s.id) + " " + s.name + " 0 \"off\" 1 \"on\" ;\n";
+		for (const auto& s : sigs)
+			if (chance(10))
+				_dbc += "SIG_VALTYPE_ " + std::to_string(s.id) + " " + s.name + " : 1;\n";
+		return std::move(_dbc);
+	}
+};
+
+static uint64_t fnv1a(const std::string& s) {
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (unsigned char c : s)
+		h = (h ^ c) * 0x100000001b3ull;
+	return h;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 3 && std::string(argv[1]) == "--dump") {
+		uint64_t seed = std::stoull(argv[2]);
+		auto dbc = dbc_generator(seed)();
+		recorder r;
+		bool ok = can::parse_dbc(dbc, std::ref(r));
+		printf("%s\n----\nparse_dbc: %d\n%s", dbc.c_str(), int(ok), r.log().c_str());
+		return 0;
+	}
+
+	uint64_t count = argc > 1 ? std::stoull(argv[1]) : 10000;
+	uint64_t first = argc > 2 ? std::stoull(argv[2]) : 1;
+	for (uint64_t seed = first; seed < first + count; ++seed) {
+		auto dbc = dbc_generator(seed)();
+		recorder r;
+		bool ok = can::parse_dbc(dbc, std::ref(r));
+		printf("%llu %d %zu %016llx\n", (unsigned long long)seed, int(ok), r.calls(), (unsigned long long)fnv1a(r.log()));
+	}
+	return 0;
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Builds dbc_fast_path_test with and without the BO_/SG_ fast path, runs both over the
+# same random DBCs and compares the callbacks they made.
+#
+#	test/dbc_fast_path_test.sh [count [first_seed]]
+#
+# Run from the repository root; CXX and CXXFLAGS are honored.
+
+set -e
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+COUNT=${1:-10000}
+FIRST=${2:-1}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+$CXX -std=c++20 $CXXFLAGS test/dbc_fast_path_test.cpp dbc/dbc_parser.cpp -I . -o "$OUT/fast"
+$CXX -std=c++20 $CXXFLAGS -DDBC_NO_FAST_PATH test/dbc_fast_path_test.cpp dbc/dbc_parser.cpp -I . -o "$OUT/grammar"
+
+# the parser reports syntax errors on stderr, the corrupted DBCs have plenty
+"$OUT/fast" "$COUNT" "$FIRST" > "$OUT/fast.txt" 2> /dev/null
+"$OUT/grammar" "$COUNT" "$FIRST" > "$OUT/grammar.txt" 2> /dev/null
+
+if cmp -s "$OUT/fast.txt" "$OUT/grammar.txt"; then
+	echo "$COUNT DBCs, $(awk '$2 == 1' "$OUT/fast.txt" | wc -l) parsed: ok"
+	exit 0
+fi
+
+SEED=$(diff "$OUT/fast.txt" "$OUT/grammar.txt" | sed -n 's/^< \([0-9]*\) .*/\1/p' | head -n 1)
+echo "$(diff "$OUT/fast.txt" "$OUT/grammar.txt" | grep -c '^<') of $COUNT DBCs differ, the first is seed $SEED"
+echo "compare the outputs of dbc_fast_path_test --dump $SEED built with and without -DDBC_NO_FAST_PATH"
+exit 1
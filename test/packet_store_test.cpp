@@ -0,0 +1,267 @@
+/*
+	Tests of can::packet_store on the local filesystem: recovery after reopening,
+	torn and corrupt records, eviction, at-least-once delivery and preallocation.
+
+	Every test works in a fresh directory under the system's temp directory, which is
+	removed afterwards. Prints the failed checks and exits with 1 if any failed.
+*/
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif // _WIN32
+
+#include "can/packet_store.h"
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+// a packet of `n_frames` frames whose ids and data are derived from `k`
+static can::frame_packet make_packet(uint32_t k, size_t n_frames = 4) {
+	can::frame_packet fp;
+	fp.prepare(1683709842 + k);
+	for (size_t i = 0; i < n_frames; ++i) {
+		fp.append(int32_t(i));
+		can_frame cf {};
+		cf.can_id = canid_t(k * 16 + i);
+		cf.len = 8;
+		for (int b = 0; b < 8; ++b)
+			cf.data[b] = uint8_t(k + i + b);
+		fp.append(cf);
+	}
+	return fp;
+}
+
+static bool same_packet(can::frame_packet_view a, const can::frame_packet& b) {
+	return a.byte_size() == b.byte_size() && std::equal(a.data_begin(), a.data_end(), b.data_begin());
+}
+
+static std::vector<fs::path> segment_files(const fs::path& dir) {
+	std::vector<fs::path> rv;
+	for (const auto& entry : fs::directory_iterator(dir))
+		if (entry.path().extension() == ".seg")
+			rv.push_back(entry.path());
+	std::sort(rv.begin(), rv.end());
+	return rv;
+}
+
+static void test_recover(const fs::path& dir) {
+	{
+		can::packet_store store(dir);
+		for (uint32_t k = 1; k <= 100; ++k)
+			CHECK(store.append(make_packet(k)));
+	}
+
+	can::packet_store store(dir);
+	CHECK(store.size() == 100);
+	CHECK(store.stats().recovered_packets == 100);
+	CHECK(store.stats().dropped_bytes == 0);
+	CHECK(store.last_seq() == 100);
+
+	uint32_t k = 1;
+	store.for_each([&](uint64_t seq, can::frame_packet_view fp) {
+		CHECK(seq == k);
+		CHECK(same_packet(fp, make_packet(k)));
+		++k;
+	});
+	CHECK(k == 101);
+
+	CHECK(store.append(make_packet(101)));
+	CHECK(store.last_seq() == 101);
+}
+
+static void test_torn_tail(const fs::path& dir) {
+	{
+		can::packet_store store(dir, { .sync_every = 1 });
+		for (uint32_t k = 1; k <= 10; ++k)
+			store.append(make_packet(k));
+	}
+
+	// a record is 16 bytes of header and the padded payload; flip a payload byte of the last one
+	size_t rec_size = 16 + ((make_packet(10).byte_size() + 7) & ~size_t(7));
+	auto seg_path = segment_files(dir).at(0);
+	{
+		std::fstream f(seg_path, std::ios::binary | std::ios::in | std::ios::out);
+		f.seekp(24 + 9 * rec_size + 20);
+		f.put('\xff');
+	}
+
+	{
+		can::packet_store store(dir);
+		CHECK(store.size() == 9);
+		CHECK(store.stats().dropped_bytes == rec_size);
+		CHECK(store.last_seq() == 9);
+		CHECK(store.append(make_packet(42)));
+	}
+
+	// the record appended over the torn one replaces it
+	can::packet_store store(dir);
+	CHECK(store.size() == 10);
+	CHECK(store.stats().dropped_bytes == 0);
+	std::vector<uint64_t> seqs;
+	store.for_each([&](uint64_t seq, can::frame_packet_view fp) {
+		seqs.push_back(seq);
+		if (seq == 10)
+			CHECK(same_packet(fp, make_packet(42)));
+	});
+	CHECK(seqs.size() == 10 && seqs.back() == 10);
+}
+
+static void test_bad_segments(const fs::path& dir) {
+	can::packet_store_options opts { .segment_size = 4096, .max_segments = 8 };
+	{
+		can::packet_store store(dir, opts);
+		for (uint32_t k = 1; k <= 100; ++k)
+			store.append(make_packet(k));
+	}
+	auto paths = segment_files(dir);
+	CHECK(paths.size() > 2);
+
+	// a truncated segment and one with a bad magic are dropped, the others are kept
+	fs::resize_file(paths[0], 1024);
+	{
+		std::fstream f(paths[1], std::ios::binary | std::ios::in | std::ios::out);
+		f.put('X');
+	}
+
+	can::packet_store store(dir, opts);
+	CHECK(segment_files(dir).size() == paths.size() - 2);
+	CHECK(store.stats().segments == paths.size() - 2);
+	CHECK(store.last_seq() == 100);
+	auto sp = store.front();
+	CHECK(sp && sp->seq > 1);
+}
+
+static void test_eviction(const fs::path& dir) {
+	can::packet_store_options opts { .segment_size = 4096, .max_segments = 3 };
+	can::packet_store store(dir, opts);
+	for (uint32_t k = 1; k <= 500; ++k)
+		CHECK(store.append(make_packet(k)));
+
+	auto st = store.stats();
+	CHECK(st.segments == 3);
+	CHECK(segment_files(dir).size() == 3);
+	CHECK(st.evicted_packets > 0);
+	CHECK(st.packets + st.evicted_packets == 500);
+
+	// the oldest packets were evicted, the newest kept in order
+	auto sp = store.front();
+	CHECK(sp && sp->seq == st.evicted_packets + 1);
+	uint64_t expected = st.evicted_packets + 1;
+	store.for_each([&](uint64_t seq, can::frame_packet_view fp) {
+		CHECK(seq == expected);
+		CHECK(same_packet(fp, make_packet(uint32_t(seq))));
+		++expected;
+	});
+	CHECK(expected == 501);
+
+	// a packet larger than a segment is refused
+	CHECK(!store.append(make_packet(1, 400)));
+}
+
+static void test_at_least_once(const fs::path& dir) {
+	can::packet_store_options opts { .segment_size = 4096, .max_segments = 16 };
+	// the segment header, the records, and the terminator after the last one
+	size_t rec_size = 16 + ((make_packet(1).byte_size() + 7) & ~size_t(7));
+	size_t per_segment = (opts.segment_size - 24 - 8) / rec_size;
+	{
+		can::packet_store store(dir, opts);
+		for (uint32_t k = 1; k <= 100; ++k)
+			store.append(make_packet(k));
+		CHECK(store.stats().segments == (100 + per_segment - 1) / per_segment);
+
+		// consume the first segment and a few packets of the second
+		for (size_t i = 0; i < per_segment + 3; ++i) {
+			auto sp = store.front();
+			CHECK(sp && sp->seq == i + 1);
+			store.pop_front();
+		}
+		CHECK(store.size() == 100 - per_segment - 3);
+	}
+
+	// the consumed segment is gone; the partially consumed one is read again from its start
+	can::packet_store store(dir, opts);
+	auto sp = store.front();
+	CHECK(sp && sp->seq == per_segment + 1);
+	CHECK(store.last_seq() == 100);
+
+	uint64_t expected = sp ? sp->seq : 0;
+	while (auto p = store.front()) {
+		CHECK(p->seq == expected);
+		++expected;
+		store.pop_front();
+	}
+	CHECK(expected == 101);
+	CHECK(store.empty());
+	CHECK(segment_files(dir).size() == 1);
+}
+
+static void test_preallocated(const fs::path& dir) {
+	can::packet_store_options opts { .segment_size = 64 * 1024 };
+	can::packet_store store(dir, opts);
+	store.append(make_packet(1));
+
+	auto paths = segment_files(dir);
+	CHECK(paths.size() == 1);
+	CHECK(fs::file_size(paths[0]) == opts.segment_size);
+#ifndef _WIN32
+	// all blocks are allocated up front, the file isn't sparse
+	struct stat st;
+	CHECK(::stat(paths[0].c_str(), &st) == 0);
+	CHECK(size_t(st.st_blocks) * 512 >= opts.segment_size);
+#endif // _WIN32
+}
+
+// empty and truncated views iterate over their whole frames only
+static void test_short_packets(const fs::path&) {
+	auto fp = make_packet(1, 2);
+	const uint8_t* b = fp.data_begin();
+	std::pair<can::frame_packet_view, size_t> views[] = {
+		{ {}, 0 }, { { b, b + 3 }, 0 }, { { b, b + 6 }, 0 }, { { b, b + 16 }, 0 },
+		{ { b, fp.data_end() - 5 }, 1 }, { fp, 2 },
+	};
+	for (auto [view, expected] : views) {
+		size_t frames = 0;
+		for (auto it = can::begin(view); it != can::end(view); ++it)
+			++frames;
+		CHECK(frames == expected);
+	}
+}
+
+int main() {
+	std::pair<const char*, std::function<void(const fs::path&)>> tests[] = {
+		{ "recover", test_recover },
+		{ "torn_tail", test_torn_tail },
+		{ "bad_segments", test_bad_segments },
+		{ "eviction", test_eviction },
+		{ "at_least_once", test_at_least_once },
+		{ "preallocated", test_preallocated },
+		{ "short_packets", test_short_packets },
+	};
+
+	fs::path root = fs::temp_directory_path() / "packet_store_test";
+	for (const auto& [name, test] : tests) {
+		int before = failures;
+		fs::remove_all(root);
+		test(root / name);
+		fs::remove_all(root);
+		printf("%s: %s\n", name, failures == before ? "ok" : "FAILED");
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,214 @@
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <condition_variable>
+
+#include "v2c_decode.h"
+
+namespace can {
+
+bool decode_model::load_dbc(std::string_view dbc_src, uint8_t bus) {
+	_loading_bus = bus;
+	bool parsed = parse_dbc(dbc_src, std::ref(*this), handled_sections<decode_model>);
+	_loading_bus = 0;
+	return parsed;
+}
+
+void decode_model::add_message(canid_t message_id) {
+	_messages.try_emplace(bus_msg_key(_loading_bus, message_id));
+}
+
+void decode_model::add_signal(canid_t message_id, decode_signal_def sig) {
+	auto msg_it = _messages.find(bus_msg_key(_loading_bus, message_id));
+	if (msg_it == _messages.end())
+		return;
+	sig.message_id = message_id;
+	sig.bus = _loading_bus;
+	msg_it->second.signals.push_back(uint32_t(_signals.size()));
+	_signals.push_back(std::move(sig));
+}
+
+// The multiplexer switch is decoded as a signal too.
+
+void decode_model::add_muxer(canid_t message_id, std::string_view name, sig_codec codec) {
+	auto msg_it = _messages.find(bus_msg_key(_loading_bus, message_id));
+	if (msg_it == _messages.end())
+		return;
+	msg_it->second.mux = codec;
+	add_signal(message_id, {
+		.name = _strings->intern(name),
+		.unit = _strings->intern(""),
+		.codec = codec,
+		.phys = { 1, 0 },
+		.val_type = codec.sign_type() == '+' ? u64 : i64
+	});
+}
+
+// As tr_signal::value_type().
+
+void decode_model::set_sig_val_type(canid_t message_id, std::string_view sig_name, unsigned sig_ext_val_type) {
+	auto msg_it = _messages.find(bus_msg_key(_loading_bus, message_id));
+	if (msg_it == _messages.end())
+		return;
+	for (uint32_t idx : msg_it->second.signals) {
+		auto& sig = _signals[idx];
+		if (interned(sig.name) != sig_name)
+			continue;
+		sig.val_type = val_type_t(sig_ext_val_type);
+		if (sig.val_type == i64 && sig.codec.sign_type() == '+')
+			sig.val_type = u64;
+		return;
+	}
+}
+
+bool decode_model::decode(can_time stamp, const can_frame& frame, std::vector<decoded_signal>& out) const {
+	auto msg_it = _messages.find(bus_msg_key(frame_bus(frame), frame.can_id));
+	if (msg_it == _messages.end())
+		return false;
+
+	// the codecs load 8 bytes from the signal's first byte
+	uint8_t data[2 * CAN_MAX_DLEN] = {};
+	std::memcpy(data, frame.data, CAN_MAX_DLEN);
+
+	const auto& md = msg_it->second;
+	int64_t frame_mux = md.mux ? int64_t((*md.mux)(data)) : -1;
+	for (uint32_t idx : md.signals) {
+		const auto& sig = _signals[idx];
+		if (sig.mux_val && *sig.mux_val != frame_mux)
+			continue;
+		uint64_t raw = sig.codec(data);
+		out.push_back({ stamp, idx, raw, sig.phys(raw, sig.val_type) });
+	}
+	return true;
+}
+
+namespace {
+
+// the values of a chunk of packets, in order
+struct decoded_chunk {
+	std::vector<decoded_signal> values;
+	std::vector<size_t> packet_ends;
+};
+
+class packet_decoder {
+	std::span<const frame_packet_view> _packets;
+	const decode_model& _model;
+	decoded_sink& _sink;
+	decode_options _opts;
+	size_t _chunks;
+	std::atomic<size_t> _next = 0;
+
+	// ordered delivery: chunks decoded ahead of the next one to deliver wait in _window
+	std::mutex _lock;
+	std::condition_variable _delivered_cv;
+	std::vector<std::optional<decoded_chunk>> _window;
+	size_t _delivered = 0;
+	bool _delivering = false;
+
+public:
+	packet_decoder(std::span<const frame_packet_view> packets, const decode_model& model, decoded_sink& sink, const decode_options& opts) :
+		_packets(packets), _model(model), _sink(sink), _opts(opts)
+	{
+		_opts.chunk = std::max<size_t>(_opts.chunk, 1);
+		_chunks = (packets.size() + _opts.chunk - 1) / _opts.chunk;
+		_window.resize(4 * size_t(std::max(1u, _opts.threads)));
+	}
+
+	size_t chunks() const { return _chunks; }
+
+	void work(decode_stats& stats) {
+		decoded_chunk dc;
+		for (size_t c; (c = _next.fetch_add(1, std::memory_order_relaxed)) < _chunks; ) {
+			size_t first = c * _opts.chunk, last = std::min(first + _opts.chunk, _packets.size());
+			if (!_opts.ordered) {
+				for (size_t p = first; p < last; ++p) {
+					dc.values.clear();
+					decode(_packets[p], dc.values, stats);
+					_sink(p, dc.values);
+				}
+				continue;
+			}
+
+			wait_window(c);
+			dc.values.clear();
+			dc.packet_ends.clear();
+			for (size_t p = first; p < last; ++p) {
+				decode(_packets[p], dc.values, stats);
+				dc.packet_ends.push_back(dc.values.size());
+			}
+			deliver(c, std::move(dc));
+			dc = {};
+		}
+	}
+
+private:
+	void decode(frame_packet_view fp, std::vector<decoded_signal>& values, decode_stats& stats) {
+		++stats.packets;
+		size_t before = values.size();
+		for (const auto& [stamp, frame] : fp) {
+			++stats.frames;
+			if (!_model.decode(stamp, frame, values))
+				++stats.unknown_frames;
+		}
+		stats.values += values.size() - before;
+	}
+
+	void wait_window(size_t c) {
+		std::unique_lock lock(_lock);
+		_delivered_cv.wait(lock, [&] { return c < _delivered + _window.size(); });
+	}
+
+	// Stores the chunk and, unless another thread is delivering, delivers the chunks that are next in order.
+	void deliver(size_t c, decoded_chunk&& dc) {
+		std::unique_lock lock(_lock);
+		_window[c % _window.size()] = std::move(dc);
+		if (_delivering)
+			return;
+		_delivering = true;
+		while (auto& slot = _window[_delivered % _window.size()]) {
+			decoded_chunk next = std::move(*slot);
+			slot.reset();
+			lock.unlock();
+
+			size_t first = _delivered * _opts.chunk, begin = 0;
+			for (size_t i = 0; i < next.packet_ends.size(); ++i) {
+				size_t end = next.packet_ends[i];
+				_sink(first + i, std::span(next.values).subspan(begin, end - begin));
+				begin = end;
+			}
+
+			lock.lock();
+			++_delivered;
+			_delivered_cv.notify_all();
+		}
+		_delivering = false;
+	}
+};
+
+} // end anonymous namespace
+
+decode_stats decode_packets(
+	std::span<const frame_packet_view> packets, const decode_model& model, decoded_sink sink,
+	const decode_options& opts
+) {
+	packet_decoder decoder(packets, model, sink, opts);
+	size_t nthreads = std::min<size_t>(std::max(1u, opts.threads), decoder.chunks());
+	std::vector<decode_stats> stats(std::max<size_t>(nthreads, 1));
+	{
+		std::vector<std::jthread> workers;
+		for (size_t i = 1; i < nthreads; ++i)
+			workers.emplace_back([&, i] { decoder.work(stats[i]); });
+		decoder.work(stats[0]);
+	}
+
+	decode_stats rv;
+	for (const auto& s : stats) {
+		rv.packets += s.packets;
+		rv.frames += s.frames;
+		rv.values += s.values;
+		rv.unknown_frames += s.unknown_frames;
+	}
+	return rv;
+}
+
+} // end namespace can
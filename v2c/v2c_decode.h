@@ -0,0 +1,151 @@
+#pragma once
+
+#include <span>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+
+#include "any/any.h"
+#include "can/can_codec.h"
+#include "can/frame_packet.h"
+#include "dbc/dbc_parser.h"
+#include "v2c/v2c_transcoder.h"
+
+/*
+
+Bulk decoding of frame_packets into physical signal values, e.g. to reprocess an
+archive of uploads.
+
+decode_model holds what decoding needs from the DBCs: the signals of every message,
+with their codecs, multiplexer values, factors, offsets, value types, and interned
+names and units. It is read-only once loaded, so any number of threads can decode
+with it.
+
+decode_packets() decodes a span of packets on `threads` threads. The threads take
+chunks of `chunk` consecutive packets at a time, and the sink gets the values of one
+packet per call. With `ordered`, the sink is called on one thread at a time, in the
+order of the packets; at most a few chunks per thread wait to be delivered. Without
+it, the sink is called concurrently, as soon as a packet is decoded.
+
+	can::decode_model model;
+	model.load_dbc(dbc_src);
+	can::decode_packets(packets, model, [&](size_t packet, std::span<const can::decoded_signal> values) {
+		for (const auto& v : values)
+			write(v.stamp, can::interned(model.signal(v.signal).name), v.value);
+	}, { .ordered = true });
+
+*/
+
+namespace can {
+
+struct decode_signal_def {
+	str_handle name; // interned, see v2c_strings.h
+	str_handle unit;
+	canid_t message_id;
+	uint8_t bus;
+	sig_codec codec;
+	std::optional<int64_t> mux_val; // active only for frames with this multiplexer value
+	phys_value phys;
+	val_type_t val_type;
+};
+
+struct decoded_signal {
+	can_time stamp;
+	uint32_t signal; // decode_model::signal()
+	uint64_t raw;
+	double value;
+};
+
+class decode_model {
+	struct message_def {
+		std::optional<sig_codec> mux;
+		std::vector<uint32_t> signals;
+	};
+
+	std::vector<decode_signal_def> _signals;
+	std::unordered_map<uint64_t, message_def> _messages; // by bus_msg_key()
+	uint8_t _loading_bus = 0;
+	std::unique_ptr<string_table> _strings = std::make_unique<string_table>(); // names and units of the signals
+
+public:
+	// Loads the DBC of CAN bus `bus`.
+	bool load_dbc(std::string_view dbc_src, uint8_t bus = 0);
+
+	const decode_signal_def& signal(uint32_t idx) const { return _signals[idx]; }
+	size_t signal_count() const { return _signals.size(); }
+
+	// Appends the values of the active signals of the frame. Returns false for unknown messages.
+	bool decode(can_time stamp, const can_frame& frame, std::vector<decoded_signal>& out) const;
+
+	void add_message(canid_t message_id);
+	void add_signal(canid_t message_id, decode_signal_def sig);
+	void add_muxer(canid_t message_id, std::string_view name, sig_codec codec);
+	void set_sig_val_type(canid_t message_id, std::string_view sig_name, unsigned sig_ext_val_type);
+	string_table& strings() { return *_strings; }
+};
+
+using decoded_sink = mireo::any_function<void(size_t, std::span<const decoded_signal>)>;
+
+struct decode_options {
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t chunk = 64;    // packets a thread takes at a time
+	bool ordered = false; // deliver the packets in order, on one thread at a time
+};
+
+struct decode_stats {
+	uint64_t packets = 0;
+	uint64_t frames = 0;
+	uint64_t values = 0;
+	uint64_t unknown_frames = 0;
+};
+
+decode_stats decode_packets(
+	std::span<const frame_packet_view> packets, const decode_model& model, decoded_sink sink,
+	const decode_options& opts = {}
+);
+
+// tag-invokes used by dbc_parser.cpp
+
+inline void tag_invoke(
+	def_bo_view_cpo, decode_model& this_,
+	uint32_t message_id, std::string_view msg_name, size_t msg_size, size_t transmitter_ord
+) {
+	this_.add_message(message_id);
+}
+
+inline void tag_invoke(
+	def_sg_view_cpo, decode_model& this_,
+	uint32_t message_id, std::optional<unsigned> sg_mux_switch_val, std::string_view sg_name,
+	unsigned sg_start_bit, unsigned sg_size, char sg_byte_order, char sg_sign,
+	double sg_factor, double sg_offset, double sg_min, double sg_max,
+	std::string_view sg_unit, std::span<const size_t> rec_ords
+) {
+	this_.add_signal(message_id, {
+		.name = this_.strings().intern(sg_name),
+		.unit = this_.strings().intern(sg_unit),
+		.codec = { sg_start_bit, sg_size, sg_byte_order, sg_sign },
+		.mux_val = sg_mux_switch_val ? std::optional<int64_t>(*sg_mux_switch_val) : std::nullopt,
+		.phys = { sg_factor, sg_offset },
+		.val_type = sg_sign == '+' ? u64 : i64
+	});
+}
+
+inline void tag_invoke(
+	def_sg_mux_view_cpo, decode_model& this_,
+	uint32_t message_id, std::string_view sg_name,
+	unsigned sg_start_bit, unsigned sg_size, char sg_byte_order, char sg_sign,
+	std::string_view sg_unit, std::span<const size_t> rec_ords
+) {
+	this_.add_muxer(message_id, sg_name, { sg_start_bit, sg_size, sg_byte_order, sg_sign });
+}
+
+inline void tag_invoke(
+	def_sig_valtype_view_cpo, decode_model& this_,
+	unsigned message_id, std::string_view sig_name, unsigned sig_ext_val_type
+) {
+	this_.set_sig_val_type(message_id, sig_name, sig_ext_val_type);
+}
+
+} // end namespace can
@@ -0,0 +1,131 @@
+#include <cstdio>
+#include <cstdarg>
+
+#include "v2c_metrics.h"
+
+namespace can {
+
+uint64_t histogram_snapshot::quantile(double q) const {
+	if (count == 0)
+		return 0;
+
+	uint64_t rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+	uint64_t seen = 0;
+	for (size_t i = 0; i < buckets.size(); ++i) {
+		seen += buckets[i];
+		if (seen >= rank)
+			return upper_bound(i);
+	}
+	return upper_bound(buckets.size() - 1);
+}
+
+[[gnu::format(printf, 2, 3)]]
+static void appendf(std::string& out, const char* fmt, ...) {
+	char buf[256];
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	if (n < 0)
+		return;
+	if (size_t(n) < sizeof(buf)) {
+		out.append(buf, n);
+		return;
+	}
+
+	// long group names, format once more straight into the string
+	size_t at = out.size();
+	out.resize(at + n + 1);
+	va_start(args, fmt);
+	vsnprintf(out.data() + at, n + 1, fmt, args);
+	va_end(args);
+	out.resize(at + n);
+}
+
+static unsigned long long ull(uint64_t v) { return v; }
+
+static void append_json(std::string& out, const histogram_snapshot& hs) {
+	appendf(out, R"({"count":%llu,"sum":%llu,"p50":%llu,"p90":%llu,"p99":%llu,"max":%llu})",
+		ull(hs.count), ull(hs.sum), ull(hs.quantile(0.5)), ull(hs.quantile(0.9)),
+		ull(hs.quantile(0.99)), ull(hs.quantile(1)));
+}
+
+std::string to_json(const v2c_metrics_snapshot& ms) {
+	std::string rv;
+	appendf(rv,
+		R"({"frames_in":%llu,"unknown_frames":%llu,"ungrouped_frames":%llu,"packets_out":%llu,"bytes_out":%llu,"transcode_ns":)",
+		ull(ms.frames_in), ull(ms.unknown_frames), ull(ms.ungrouped_frames), ull(ms.packets_out), ull(ms.bytes_out)
+	);
+	append_json(rv, ms.transcode_ns);
+	rv += R"(,"packet_bytes":)";
+	append_json(rv, ms.packet_bytes);
+	rv += R"(,"groups":[)";
+	for (size_t i = 0; i < ms.groups.size(); ++i) {
+		const auto& g = ms.groups[i];
+		appendf(rv, R"(%s{"name":"%s","windows":%llu,"published":%llu,"dropped":%llu,"frames_out":%llu,"publish_ns":)",
+			i ? "," : "", g.name.c_str(), ull(g.windows), ull(g.published), ull(g.dropped), ull(g.frames_out));
+		append_json(rv, g.publish_ns);
+		rv += '}';
+	}
+	rv += "]}";
+	return rv;
+}
+
+// Prometheus buckets are cumulative; trailing empty buckets are left out
+static void append_prometheus(std::string& out, const std::string& name, const std::string& labels, const histogram_snapshot& hs) {
+	const char* sep = labels.empty() ? "" : ",";
+	size_t last = hs.buckets.size();
+	while (last > 0 && hs.buckets[last - 1] == 0)
+		--last;
+
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < last; ++i) {
+		cumulative += hs.buckets[i];
+		appendf(out, "%s_bucket{%s%sle=\"%llu\"} %llu\n",
+			name.c_str(), labels.c_str(), sep, ull(histogram_snapshot::upper_bound(i)), ull(cumulative));
+	}
+	appendf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name.c_str(), labels.c_str(), sep, ull(hs.count));
+
+	std::string braced = labels.empty() ? "" : "{" + labels + "}";
+	appendf(out, "%s_sum%s %llu\n", name.c_str(), braced.c_str(), ull(hs.sum));
+	appendf(out, "%s_count%s %llu\n", name.c_str(), braced.c_str(), ull(hs.count));
+}
+
+std::string to_prometheus(const v2c_metrics_snapshot& ms, const std::string& prefix) {
+	const char* p = prefix.c_str();
+	std::string rv;
+
+	auto counter = [&](const char* name, uint64_t value) {
+		appendf(rv, "# TYPE %s_%s_total counter\n%s_%s_total %llu\n", p, name, p, name, ull(value));
+	};
+	counter("frames_in", ms.frames_in);
+	counter("unknown_frames", ms.unknown_frames);
+	counter("ungrouped_frames", ms.ungrouped_frames);
+	counter("packets_out", ms.packets_out);
+	counter("bytes_out", ms.bytes_out);
+
+	appendf(rv, "# TYPE %s_transcode_ns histogram\n", p);
+	append_prometheus(rv, prefix + "_transcode_ns", "", ms.transcode_ns);
+	appendf(rv, "# TYPE %s_packet_bytes histogram\n", p);
+	append_prometheus(rv, prefix + "_packet_bytes", "", ms.packet_bytes);
+
+	if (ms.groups.empty())
+		return rv;
+
+	auto group_counter = [&](const char* name, uint64_t tx_group_metrics_snapshot::* field) {
+		appendf(rv, "# TYPE %s_group_%s_total counter\n", p, name);
+		for (const auto& g : ms.groups)
+			appendf(rv, "%s_group_%s_total{group=\"%s\"} %llu\n", p, name, g.name.c_str(), ull(g.*field));
+	};
+	group_counter("windows", &tx_group_metrics_snapshot::windows);
+	group_counter("published", &tx_group_metrics_snapshot::published);
+	group_counter("dropped", &tx_group_metrics_snapshot::dropped);
+	group_counter("frames_out", &tx_group_metrics_snapshot::frames_out);
+
+	appendf(rv, "# TYPE %s_group_publish_ns histogram\n", p);
+	for (const auto& g : ms.groups)
+		append_prometheus(rv, prefix + "_group_publish_ns", "group=\"" + g.name + "\"", g.publish_ns);
+	return rv;
+}
+
+} // end namespace can
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <bit>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+/*
+
+Runtime counters and latency histograms of a v2c_transcoder, or of a v2c_session
+created with session_options::metrics.
+
+Every metric has a single writer (the thread calling transcode()), so updates are
+plain relaxed load/store pairs, without locked read-modify-write instructions.
+Any other thread can take a snapshot at any time with relaxed loads.
+
+Latencies are sampled: one transcode() call in `timing_sample_every` is timed.
+
+Define V2C_NO_METRICS to compile all of it out; snapshots are then all zeros.
+
+*/
+
+namespace can {
+
+#ifdef V2C_NO_METRICS
+inline constexpr bool metrics_enabled = false;
+#else // V2C_NO_METRICS
+inline constexpr bool metrics_enabled = true;
+#endif // V2C_NO_METRICS
+
+class metric_counter {
+#ifndef V2C_NO_METRICS
+	std::atomic<uint64_t> _value { 0 };
+#endif // V2C_NO_METRICS
+public:
+	void add(uint64_t n = 1) {
+#ifndef V2C_NO_METRICS
+		_value.store(_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+#endif // V2C_NO_METRICS
+	}
+
+	uint64_t value() const {
+#ifndef V2C_NO_METRICS
+		return _value.load(std::memory_order_relaxed);
+#else // V2C_NO_METRICS
+		return 0;
+#endif // V2C_NO_METRICS
+	}
+};
+
+struct histogram_snapshot {
+	static constexpr size_t num_buckets = 40;
+
+	// bucket i counts values in [2^(i-1), 2^i), bucket 0 counts zeros
+	std::array<uint64_t, num_buckets> buckets {};
+	uint64_t count = 0;
+	uint64_t sum = 0;
+
+	static uint64_t upper_bound(size_t bucket) { return bucket == 0 ? 0 : (1ull << bucket) - 1; }
+	uint64_t quantile(double q) const;
+};
+
+class metric_histogram {
+#ifndef V2C_NO_METRICS
+	std::array<metric_counter, histogram_snapshot::num_buckets> _buckets;
+	metric_counter _count, _sum;
+#endif // V2C_NO_METRICS
+public:
+	void record(uint64_t value) {
+#ifndef V2C_NO_METRICS
+		size_t bucket = std::bit_width(value);
+		_buckets[bucket < histogram_snapshot::num_buckets ? bucket : histogram_snapshot::num_buckets - 1].add();
+		_count.add();
+		_sum.add(value);
+#endif // V2C_NO_METRICS
+	}
+
+	histogram_snapshot snapshot() const {
+		histogram_snapshot rv;
+#ifndef V2C_NO_METRICS
+		for (size_t i = 0; i < rv.buckets.size(); ++i)
+			rv.buckets[i] = _buckets[i].value();
+		rv.count = _count.value();
+		rv.sum = _sum.value();
+#endif // V2C_NO_METRICS
+		return rv;
+	}
+};
+
+// Times a scope into a histogram, in nanoseconds, when there is one and `sampled` is set.
+class metric_timer {
+#ifndef V2C_NO_METRICS
+	metric_histogram* _hist = nullptr;
+	std::chrono::steady_clock::time_point _start;
+#endif // V2C_NO_METRICS
+public:
+	metric_timer(metric_histogram* hist, bool sampled) {
+#ifndef V2C_NO_METRICS
+		if (hist && sampled) {
+			_hist = hist;
+			_start = std::chrono::steady_clock::now();
+		}
+#endif // V2C_NO_METRICS
+	}
+
+	~metric_timer() {
+#ifndef V2C_NO_METRICS
+		if (_hist)
+			_hist->record((std::chrono::steady_clock::now() - _start) / std::chrono::nanoseconds(1));
+#endif // V2C_NO_METRICS
+	}
+
+	metric_timer(const metric_timer&) = delete;
+	metric_timer& operator=(const metric_timer&) = delete;
+};
+
+struct tx_group_metrics {
+	metric_counter windows;        // aggregation windows closed
+	metric_counter published;      // windows appended to the frame_packet
+	metric_counter dropped;        // windows dropped because not all messages arrived
+	metric_counter frames_out;     // can_frames appended to the frame_packet
+	metric_histogram publish_ns;
+};
+
+struct v2c_metrics {
+	static constexpr uint64_t timing_sample_every = 64;
+
+	metric_counter frames_in;
+	metric_counter unknown_frames;    // CAN ID not in the DBC
+	metric_counter ungrouped_frames;  // message not assigned to any tx_group
+	metric_counter packets_out;
+	metric_counter bytes_out;
+	metric_histogram transcode_ns;
+	metric_histogram packet_bytes;
+	std::vector<std::unique_ptr<tx_group_metrics>> groups; // in the order of the schema's groups
+};
+
+struct tx_group_metrics_snapshot {
+	std::string name;
+	uint64_t windows = 0;
+	uint64_t published = 0;
+	uint64_t dropped = 0;
+	uint64_t frames_out = 0;
+	histogram_snapshot publish_ns;
+};
+
+struct v2c_metrics_snapshot {
+	uint64_t frames_in = 0;
+	uint64_t unknown_frames = 0;
+	uint64_t ungrouped_frames = 0;
+	uint64_t packets_out = 0;
+	uint64_t bytes_out = 0;
+	histogram_snapshot transcode_ns;
+	histogram_snapshot packet_bytes;
+	std::vector<tx_group_metrics_snapshot> groups;
+};
+
+std::string to_json(const v2c_metrics_snapshot& ms);
+std::string to_prometheus(const v2c_metrics_snapshot& ms, const std::string& prefix = "v2c");
+
+} // end namespace can
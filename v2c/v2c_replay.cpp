@@ -0,0 +1,75 @@
+#include <thread>
+
+#include "v2c_replay.h"
+
+namespace can {
+
+static double per_sec(uint64_t n, std::chrono::nanoseconds t) {
+	return t.count() ? n * 1e9 / t.count() : 0;
+}
+
+double replay_stats::frames_per_sec() const {
+	return per_sec(frames, wall_time);
+}
+
+double replay_stats::packets_per_sec() const {
+	return per_sec(packets, wall_time);
+}
+
+v2c_replay::v2c_replay(v2c_transcoder& transcoder, packet_sink sink, replay_options opts) :
+	_transcoder(transcoder), _sink(std::move(sink)), _opts(opts)
+{}
+
+void v2c_replay::pace(can_time stamp) const {
+	if (_opts.speed <= 0)
+		return;
+
+	using namespace std::chrono;
+	auto trace_elapsed = duration<double>(stamp - _first_stamp) / _opts.speed;
+	std::this_thread::sleep_until(_wall_start + duration_cast<wall_clock::duration>(trace_elapsed));
+}
+
+void v2c_replay::emit(frame_packet fp) {
+	if (fp.empty())
+		return;
+
+	++_stats.packets;
+	_stats.bytes_out += fp.byte_size();
+	for (auto b = fp.data_begin(); b != fp.data_end(); ++b)
+		_stats.digest = (_stats.digest ^ *b) * 0x100000001b3;
+
+	_sink(std::move(fp));
+}
+
+void v2c_replay::feed(can_time stamp, can_frame frame) {
+	if (_stats.frames == 0) {
+		_first_stamp = stamp;
+		_wall_start = wall_clock::now();
+	}
+
+	pace(stamp);
+
+	++_stats.frames;
+	_last_stamp = stamp;
+	emit(_transcoder.transcode(stamp, frame));
+}
+
+void v2c_replay::feed(std::span<const timed_frame> frames) {
+	for (const auto& [stamp, frame] : frames)
+		feed(stamp, frame);
+}
+
+void v2c_replay::finish() {
+	emit(_transcoder.flush());
+	_stats.wall_time = wall_clock::now() - _wall_start;
+}
+
+replay_stats v2c_replay::stats() const {
+	auto rv = _stats;
+	rv.trace_time = _last_stamp - _first_stamp;
+	if (rv.wall_time.count() == 0 && rv.frames)
+		rv.wall_time = wall_clock::now() - _wall_start;
+	return rv;
+}
+
+} // end namespace can
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <span>
+#include <chrono>
+
+#include "any/any.h"
+#include "can/frame_packet.h"
+#include "v2c/v2c_transcoder.h"
+
+namespace can {
+
+// Plays recorded frames through a v2c_transcoder. The transcoder only ever sees
+// the recorded timestamps (the virtual clock), so the same trace always yields
+// the same frame_packets, no matter how fast it is replayed.
+
+struct replay_options {
+	double speed = 0; // 0 replays as fast as possible, 1 in real time, 10 ten times faster
+};
+
+struct replay_stats {
+	uint64_t frames = 0;
+	uint64_t packets = 0;
+	uint64_t bytes_out = 0;
+	uint64_t digest = 0xcbf29ce484222325; // FNV-1a of all packet bytes, equal across identical runs
+	std::chrono::nanoseconds wall_time { 0 };
+	std::chrono::nanoseconds trace_time { 0 };
+
+	double frames_per_sec() const;
+	double packets_per_sec() const;
+};
+
+using packet_sink = mireo::any_function<void(frame_packet&&)>;
+
+class v2c_replay {
+	using wall_clock = std::chrono::steady_clock;
+
+	v2c_transcoder& _transcoder;
+	packet_sink _sink;
+	replay_options _opts;
+
+	can_time _first_stamp {};
+	can_time _last_stamp {};
+	wall_clock::time_point _wall_start {};
+	replay_stats _stats;
+
+public:
+	v2c_replay(v2c_transcoder& transcoder, packet_sink sink, replay_options opts = {});
+
+	void feed(can_time stamp, can_frame frame);
+	void feed(std::span<const timed_frame> frames);
+	void finish();
+
+	replay_stats stats() const;
+
+private:
+	void pace(can_time stamp) const;
+	void emit(frame_packet fp);
+};
+
+} // end namespace can
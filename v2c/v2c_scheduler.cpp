@@ -0,0 +1,230 @@
+#include "v2c_scheduler.h"
+
+namespace can {
+
+v2c_scheduler::v2c_scheduler(std::shared_ptr<const v2c_schema> schema, vehicle_packet_sink sink, const scheduler_options& opts) :
+	_schema(std::move(schema)), _sink(std::move(sink)), _opts(opts),
+	_stripes(4 * size_t(std::max(1u, opts.workers)))
+{
+	_opts.batch = std::max<size_t>(_opts.batch, 1);
+	for (unsigned i = 0; i < std::max(1u, opts.workers); ++i)
+		_workers.push_back(std::make_unique<worker>());
+	for (unsigned i = 0; i < _workers.size(); ++i)
+		_threads.emplace_back([this, i] { work(i); });
+}
+
+v2c_scheduler::~v2c_scheduler() {
+	drain();
+	{
+		std::lock_guard lock(_park_lock);
+		_stop = true;
+	}
+	_park_cv.notify_all();
+}
+
+void v2c_scheduler::submit(uint64_t vehicle_id, frame_packet&& fp) {
+	enqueue(std::move(fp), vehicle_id);
+}
+
+void v2c_scheduler::close(uint64_t vehicle_id) {
+	enqueue(std::nullopt, vehicle_id);
+}
+
+void v2c_scheduler::enqueue(std::optional<frame_packet> fp, uint64_t vehicle_id) {
+	_unprocessed.fetch_add(1);
+
+	auto& st = _stripes[std::hash<uint64_t>{}(vehicle_id) % _stripes.size()];
+	std::lock_guard stripe_lock(st.lock);
+	auto& vp = st.vehicles[vehicle_id];
+	if (!vp)
+		vp = std::make_unique<vehicle>(vehicle_id, _schema, unsigned(vehicle_id % _workers.size()));
+
+	std::lock_guard vehicle_lock(vp->lock);
+	vp->pending.push_back(std::move(fp));
+	if (!vp->scheduled) {
+		vp->scheduled = true;
+		schedule(*vp);
+	}
+}
+
+// Queues the vehicle on its worker, and wakes a parked worker to run or steal it.
+
+void v2c_scheduler::schedule(vehicle& v) {
+	auto& w = *_workers[v.worker];
+	{
+		std::lock_guard lock(w.lock);
+		w.queue.push_back(&v);
+	}
+	_queued.fetch_add(1);
+	if (_parked.load() > 0) {
+		{ std::lock_guard lock(_park_lock); }
+		_park_cv.notify_one();
+	}
+}
+
+v2c_scheduler::vehicle* v2c_scheduler::pop(unsigned self) {
+	auto& w = *_workers[self];
+	std::lock_guard lock(w.lock);
+	if (w.queue.empty())
+		return nullptr;
+	vehicle* v = w.queue.front();
+	w.queue.pop_front();
+	_queued.fetch_sub(1);
+	return v;
+}
+
+// Takes the vehicle queued last from the first other worker that has one.
+
+v2c_scheduler::vehicle* v2c_scheduler::steal(unsigned self) {
+	for (size_t i = 1; i < _workers.size(); ++i) {
+		auto& victim = *_workers[(self + i) % _workers.size()];
+		std::lock_guard lock(victim.lock);
+		if (victim.queue.empty())
+			continue;
+		vehicle* v = victim.queue.back();
+		victim.queue.pop_back();
+		_queued.fetch_sub(1);
+		_workers[self]->steals.add();
+		return v;
+	}
+	return nullptr;
+}
+
+void v2c_scheduler::park() {
+	std::unique_lock lock(_park_lock);
+	_parked.fetch_add(1);
+	// schedule() queues before it checks _parked, so a vehicle queued since is seen here
+	_park_cv.wait(lock, [this] { return _stop || _queued.load() > 0; });
+	_parked.fetch_sub(1);
+}
+
+void v2c_scheduler::work(unsigned self) {
+	while (true) {
+		vehicle* v = pop(self);
+		if (!v)
+			v = steal(self);
+		if (v) {
+			run(self, *v);
+			continue;
+		}
+		park();
+		std::lock_guard lock(_park_lock);
+		if (_stop)
+			return;
+	}
+}
+
+void v2c_scheduler::transcode(worker& w, vehicle& v, const frame_packet& fp) {
+	w.packets_in.add();
+	uint64_t frames = 0;
+	for (const auto& [stamp, frame] : fp) {
+		++frames;
+		if (auto out = v.session.transcode(stamp, frame, frame_bus(frame)); !out.empty()) {
+			w.packets_out.add();
+			_sink(v.id, std::move(out));
+		}
+	}
+	w.frames_in.add(frames);
+}
+
+// Runs up to `batch` packets of the vehicle, then queues it again if more are pending.
+
+void v2c_scheduler::run(unsigned self, vehicle& v) {
+	auto& w = *_workers[self];
+	auto start = std::chrono::steady_clock::now();
+	w.runs.add();
+
+	// the vehicle is pinned to the worker that runs it, also if stolen
+	v.worker = self;
+
+	size_t n = 0;
+	bool more = true;
+	for (; n < _opts.batch && more; ) {
+		std::optional<frame_packet> fp;
+		{
+			std::lock_guard lock(v.lock);
+			if (v.pending.empty())
+				break;
+			fp = std::move(v.pending.front());
+			v.pending.pop_front();
+		}
+		++n;
+
+		if (fp)
+			transcode(w, v, *fp);
+		else if (auto out = v.session.flush(); !out.empty()) {
+			w.packets_out.add();
+			_sink(v.id, std::move(out));
+		}
+		if (!fp)
+			more = !retire(v);
+	}
+
+	w.busy_ns.add((std::chrono::steady_clock::now() - start) / std::chrono::nanoseconds(1));
+
+	if (more) {
+		std::unique_lock lock(v.lock);
+		if (v.pending.empty())
+			v.scheduled = false;
+		else {
+			lock.unlock();
+			schedule(v);
+		}
+	}
+	processed(n);
+}
+
+// Frees a closed vehicle, unless packets were submitted after the close, which then go to
+// a fresh session. Returns whether it was freed.
+
+bool v2c_scheduler::retire(vehicle& v) {
+	auto& st = _stripes[std::hash<uint64_t>{}(v.id) % _stripes.size()];
+	std::unique_ptr<vehicle> freed;
+	{
+		std::lock_guard stripe_lock(st.lock);
+		std::lock_guard vehicle_lock(v.lock);
+		if (!v.pending.empty()) {
+			v.session = v2c_session(_schema);
+			return false;
+		}
+		auto v_it = st.vehicles.find(v.id);
+		freed = std::move(v_it->second);
+		st.vehicles.erase(v_it);
+	}
+	return true;
+}
+
+void v2c_scheduler::processed(size_t n) {
+	if (_unprocessed.fetch_sub(n) == n) {
+		{ std::lock_guard lock(_drain_lock); }
+		_drain_cv.notify_all();
+	}
+}
+
+void v2c_scheduler::drain() {
+	std::unique_lock lock(_drain_lock);
+	_drain_cv.wait(lock, [this] { return _unprocessed.load() == 0; });
+}
+
+std::vector<scheduler_worker_stats> v2c_scheduler::stats() const {
+	std::vector<scheduler_worker_stats> rv;
+	for (const auto& w : _workers) {
+		size_t queued;
+		{
+			std::lock_guard lock(w->lock);
+			queued = w->queue.size();
+		}
+		rv.push_back({
+			.packets_in = w->packets_in.value(),
+			.frames_in = w->frames_in.value(),
+			.packets_out = w->packets_out.value(),
+			.runs = w->runs.value(),
+			.steals = w->steals.value(),
+			.busy_ns = w->busy_ns.value(),
+			.queued = queued
+		});
+	}
+	return rv;
+}
+
+} // end namespace can
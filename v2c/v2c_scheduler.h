@@ -0,0 +1,142 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <optional>
+#include <condition_variable>
+#include <unordered_map>
+
+#include "any/any.h"
+#include "can/frame_packet.h"
+#include "v2c/v2c_metrics.h"
+#include "v2c/v2c_session.h"
+
+/*
+
+Transcodes the frame_packets uploaded by many vehicles on a pool of workers, one
+v2c_session per vehicle, all sharing one v2c_schema.
+
+Every vehicle is pinned to one worker at a time: submitting a packet appends it to
+the vehicle's queue and, unless the vehicle is already scheduled, queues the vehicle
+on its worker. The worker decodes the packets with frame_iterator and transcodes
+their frames in the vehicle's session, `batch` packets at a time, so the packets of
+a vehicle are transcoded in order, never by two workers at once, and one busy vehicle
+doesn't hold back the others of its worker. A worker without vehicles to run steals
+the most recently queued one from another worker, and keeps it from then on.
+
+The packets a session publishes are handed to the sink on the worker, so the sink is
+called from several threads at once, but never for the same vehicle at the same time.
+
+	can::v2c_scheduler scheduler(schema, [&](uint64_t vehicle, can::frame_packet&& fp) {
+		store(vehicle, std::move(fp));
+	});
+	scheduler.submit(vehicle, std::move(uploaded)); // from any thread
+	scheduler.close(vehicle);                        // flushes the session and frees it
+
+*/
+
+namespace can {
+
+struct scheduler_options {
+	unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+	size_t batch = 16; // packets a vehicle runs before the next one of its worker
+};
+
+struct scheduler_worker_stats {
+	uint64_t packets_in = 0;
+	uint64_t frames_in = 0;
+	uint64_t packets_out = 0;
+	uint64_t runs = 0;    // times a vehicle was run
+	uint64_t steals = 0;  // vehicles taken from other workers
+	uint64_t busy_ns = 0; // time spent running vehicles
+	size_t queued = 0;    // vehicles waiting for the worker
+};
+
+using vehicle_packet_sink = mireo::any_function<void(uint64_t, frame_packet&&)>;
+
+class v2c_scheduler {
+	struct vehicle {
+		uint64_t id;
+		v2c_session session;
+		std::mutex lock;
+		std::deque<std::optional<frame_packet>> pending; // nullopt closes the session
+		unsigned worker;
+		bool scheduled = false;
+
+		vehicle(uint64_t id, std::shared_ptr<const v2c_schema> schema, unsigned worker) :
+			id(id), session(std::move(schema)), worker(worker)
+		{}
+	};
+
+	struct stripe {
+		std::mutex lock;
+		std::unordered_map<uint64_t, std::unique_ptr<vehicle>> vehicles;
+	};
+
+	struct worker {
+		std::mutex lock;
+		std::deque<vehicle*> queue;
+
+		metric_counter packets_in;
+		metric_counter frames_in;
+		metric_counter packets_out;
+		metric_counter runs;
+		metric_counter steals;
+		metric_counter busy_ns;
+	};
+
+	std::shared_ptr<const v2c_schema> _schema;
+	vehicle_packet_sink _sink;
+	scheduler_options _opts;
+
+	std::vector<stripe> _stripes;
+	std::vector<std::unique_ptr<worker>> _workers;
+
+	std::atomic<size_t> _queued = 0; // vehicles in the workers' queues
+	std::atomic<size_t> _parked = 0;
+	std::mutex _park_lock;
+	std::condition_variable _park_cv;
+	bool _stop = false; // guarded by _park_lock
+
+	std::atomic<size_t> _unprocessed = 0; // submitted packets and closes not yet run
+	std::mutex _drain_lock;
+	std::condition_variable _drain_cv;
+
+	std::vector<std::jthread> _threads; // last, so they're joined before the rest is destroyed
+
+public:
+	v2c_scheduler(std::shared_ptr<const v2c_schema> schema, vehicle_packet_sink sink, const scheduler_options& opts = {});
+	~v2c_scheduler();
+
+	v2c_scheduler(const v2c_scheduler&) = delete;
+	v2c_scheduler& operator=(const v2c_scheduler&) = delete;
+
+	// Called from any thread.
+	void submit(uint64_t vehicle_id, frame_packet&& fp);
+	// Flushes the vehicle's session to the sink after its submitted packets and frees it.
+	void close(uint64_t vehicle_id);
+
+	// Waits until all packets submitted so far are transcoded.
+	void drain();
+
+	size_t workers() const { return _workers.size(); }
+	std::vector<scheduler_worker_stats> stats() const;
+
+private:
+	void enqueue(std::optional<frame_packet> fp, uint64_t vehicle_id);
+	void schedule(vehicle& v);
+	vehicle* pop(unsigned self);
+	vehicle* steal(unsigned self);
+	void park();
+	void run(unsigned self, vehicle& v);
+	void transcode(worker& w, vehicle& v, const frame_packet& fp);
+	bool retire(vehicle& v);
+	void processed(size_t n);
+	void work(unsigned self);
+};
+
+} // end namespace can
@@ -0,0 +1,499 @@
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <charconv>
+#include <algorithm>
+#include <unordered_set>
+
+#include "v2c_session.h"
+
+namespace can {
+
+std::shared_ptr<const v2c_schema> v2c_schema::compile(const v2c_transcoder& loaded) {
+	return compile(loaded, 0, loaded._tx_groups.size());
+}
+
+std::shared_ptr<const v2c_schema> v2c_schema::compile(const v2c_transcoder& loaded, size_t first_group, size_t last_group) {
+	auto rv = std::make_shared<v2c_schema>();
+	rv->_publish_freq = loaded._publish_freq;
+	rv->_update_freq = loaded._update_freq;
+
+	std::unordered_map<const tx_group*, uint32_t> group_idx;
+	for (size_t g = first_group; g < last_group; ++g) {
+		const auto& txg = *loaded._tx_groups[g];
+		group_idx.emplace(&txg, uint32_t(rv->_groups.size()));
+		rv->_groups.push_back({ txg._name, txg._assemble_freq, uint32_t(rv->_slots.size()), uint32_t(txg._slots.size()) });
+		for (const auto& slot : txg._slots)
+			rv->_slots.push_back({ bus_msg_key(slot.bus, slot.message_id), slot.message_mux });
+	}
+
+	uint32_t avgs = 0;
+	for (size_t bus = 0; bus < loaded._msgs.size(); ++bus) {
+		for (const auto& [message_id, msg] : loaded._msgs[bus]) {
+			uint64_t key = bus_msg_key(uint8_t(bus), message_id);
+			message_def md { .mux = msg._mux };
+
+			if (auto grp_it = group_idx.find(msg._tx_group); grp_it != group_idx.end()) {
+				md.group = grp_it->second;
+				const auto& gd = rv->_groups[md.group];
+
+				// the first run of the message's slots, the ones it assembles into
+				auto first = rv->_slots.begin() + gd.first_slot, last = first + gd.slots;
+				first = std::find_if(first, last, [&](const slot_def& sd) { return sd.key == key; });
+				md.first_slot = uint32_t(first - rv->_slots.begin());
+				md.slots = uint32_t(std::find_if(first, last, [&](const slot_def& sd) { return sd.key != key; }) - first);
+
+				// the signals of a kind next to each other, so they are assembled by the same case in a row
+				auto defs = msg._agg_defs;
+				std::stable_sort(defs.begin(), defs.end(), [](const auto& a, const auto& b) {
+					return std::make_pair(a.avg, a.val_type) < std::make_pair(b.avg, b.val_type);
+				});
+				md.first_sig = uint32_t(rv->_signals.size());
+				for (const auto& def : defs)
+					rv->_signals.push_back({ msg._signals[def.sig].layout(), def.val_type, def.avg ? avgs++ : none });
+				md.sigs = uint32_t(rv->_signals.size() - md.first_sig);
+			}
+
+			rv->_message_idx.emplace(key, uint32_t(rv->_messages.size()));
+			rv->_messages.push_back(std::move(md));
+
+			if (key == loaded._vin_key) {
+				rv->_vin_key = key;
+				rv->_vin_mux = msg._mux;
+				for (const auto& sig : msg._signals)
+					if (int chidx = vin_char(sig.name()); chidx != 0)
+						rv->_vin_sigs.emplace_back(sig.layout(), chidx);
+			}
+		}
+	}
+
+	rv->_slot_words = rv->_groups.size();
+	rv->_stamp_words = rv->_slot_words + 2 * rv->_slots.size();
+	rv->_avg_words = rv->_stamp_words + rv->_messages.size();
+	rv->_state_words = rv->_avg_words + 2 * size_t(avgs);
+	return rv;
+}
+
+std::shared_ptr<const v2c_schema> v2c_schema::compile(std::string_view dbc_src) {
+	v2c_transcoder loaded;
+	if (!loaded.load_dbc(dbc_src))
+		return nullptr;
+	return compile(loaded);
+}
+
+size_t v2c_schema::byte_size() const {
+	size_t rv = sizeof(v2c_schema) + _groups.capacity() * sizeof(group_def) +
+		_slots.capacity() * sizeof(slot_def) + _signals.capacity() * sizeof(signal_def) +
+		_messages.capacity() * sizeof(message_def) + _vin_sigs.capacity() * sizeof(_vin_sigs[0]) +
+		_message_idx.bucket_count() * sizeof(void*) +
+		_message_idx.size() * (sizeof(std::pair<const uint64_t, uint32_t>) + sizeof(void*));
+	for (const auto& gd : _groups)
+		if (gd.name.capacity() > std::string().capacity())
+			rv += gd.name.capacity() + 1;
+	return rv;
+}
+
+int v2c_schema::vin_char(std::string_view sig_name) {
+	if (sig_name.find_first_of("VIN") != 0) return 0;
+	auto rb = sig_name.rbegin();
+	while (rb != sig_name.rend() && std::isdigit(*rb)) ++rb;
+	// interned names aren't NUL-terminated, parse only the view's digits
+	int chidx = 0;
+	auto [end, ec] = std::from_chars(sig_name.data() + std::distance(rb, sig_name.rend()), sig_name.data() + sig_name.size(), chidx);
+	if (ec != std::errc{} || chidx < 1 || chidx > 17)
+		return 0;
+	return chidx;
+}
+
+v2c_session::v2c_session(std::shared_ptr<const v2c_schema> schema, const session_options& opts) :
+	_schema(std::move(schema)), _state(new uint64_t[_schema->_state_words]()), _packet_reserve(opts.packet_reserve)
+{
+	if (!opts.metrics)
+		return;
+	_metrics = std::make_unique<v2c_metrics>();
+	for (size_t g = 0; g < _schema->_groups.size(); ++g)
+		_metrics->groups.push_back(std::make_unique<tx_group_metrics>());
+}
+
+size_t v2c_session::state_bytes() const {
+	size_t rv = sizeof(*this) + _schema->_state_words * sizeof(uint64_t) + _frame_packet.byte_size();
+	if (_metrics)
+		rv += sizeof(v2c_metrics) + _metrics->groups.size() * (sizeof(tx_group_metrics) + sizeof(void*));
+	return rv;
+}
+
+static int32_t millis_diff(can_time tp, uint32_t utc) {
+	using namespace std::chrono;
+	return duration_cast<milliseconds>(tp - can_time(seconds(utc))).count();
+}
+
+frame_packet v2c_session::transcode(can_time stamp, can_frame frame, uint8_t bus) {
+	using namespace std::chrono;
+	const auto& s = *_schema;
+	v2c_metrics* m = _metrics.get();
+
+	frame_bus(frame, bus);
+
+	metric_timer timer(m ? &m->transcode_ns : nullptr, m && m->frames_in.value() % v2c_metrics::timing_sample_every == 0);
+	if (m)
+		m->frames_in.add();
+
+	setup_timers(stamp);
+
+	if (s._update_freq.count() && _last_update_tp + s._update_freq <= stamp) {
+		store_assembled(_last_update_tp + s._update_freq, _frame_packet);
+		while (_last_update_tp + s._update_freq <= stamp)
+			_last_update_tp += s._update_freq;
+	}
+
+	can_time frame_begin { seconds(_frame_packet.utc()) };
+	can_time frame_end = frame_begin + s._publish_freq;
+
+	frame_packet rv {};
+
+	if (stamp < frame_begin || stamp >= frame_end) {
+		if (!_frame_packet.empty()) {
+			rv = std::move(_frame_packet);
+			count_packet(rv);
+		}
+		_frame_packet.prepare(duration_cast<seconds>(stamp.time_since_epoch()).count(), _packet_reserve);
+	}
+
+	uint64_t key = bus_msg_key(bus, frame.can_id);
+	if (auto msg_it = s._message_idx.find(key); msg_it != s._message_idx.end()) {
+		if (key == s._vin_key)
+			decode_vin(frame);
+		if (m && s._messages[msg_it->second].group == v2c_schema::none)
+			m->ungrouped_frames.add();
+		assemble(msg_it->second, stamp, frame);
+	}
+	else if (m)
+		m->unknown_frames.add();
+	return rv;
+}
+
+// hands over the frames published so far, e.g. at the end of a recorded trace
+
+frame_packet v2c_session::flush() {
+	frame_packet rv {};
+
+	if (_last_update_tp == can_time{} || _frame_packet.empty())
+		return rv;
+
+	uint32_t utc = _frame_packet.utc();
+	rv = std::move(_frame_packet);
+	_frame_packet.prepare(utc, _packet_reserve);
+	count_packet(rv);
+	return rv;
+}
+
+std::string v2c_session::vin() const {
+	constexpr uint32_t all = (1 << sizeof(_vin)) - 1;
+	return _vin_bits == all ? std::string{ _vin, _vin + sizeof(_vin) } : std::string{};
+}
+
+v2c_metrics_snapshot v2c_session::metrics_snapshot() const {
+	v2c_metrics_snapshot rv;
+	if (!_metrics)
+		return rv;
+
+	rv.frames_in = _metrics->frames_in.value();
+	rv.unknown_frames = _metrics->unknown_frames.value();
+	rv.ungrouped_frames = _metrics->ungrouped_frames.value();
+	rv.packets_out = _metrics->packets_out.value();
+	rv.bytes_out = _metrics->bytes_out.value();
+	rv.transcode_ns = _metrics->transcode_ns.snapshot();
+	rv.packet_bytes = _metrics->packet_bytes.snapshot();
+	for (size_t g = 0; g < _metrics->groups.size(); ++g) {
+		const auto& gm = *_metrics->groups[g];
+		rv.groups.push_back({
+			.name = _schema->_groups[g].name,
+			.windows = gm.windows.value(),
+			.published = gm.published.value(),
+			.dropped = gm.dropped.value(),
+			.frames_out = gm.frames_out.value(),
+			.publish_ns = gm.publish_ns.snapshot()
+		});
+	}
+	return rv;
+}
+
+// Switches to `next`, compiled from a new DBC, between two transcode() calls. Groups with the same
+// name and frequency keep their window, metrics and the last assembled values of the messages that
+// are kept, messages whose aggregated signals, multiplexer and group didn't change keep their running
+// sums, and the packet being filled, the timers, the metrics and the VIN collected so far are kept too.
+// The rest starts empty.
+
+void v2c_session::reload(std::shared_ptr<const v2c_schema> next) {
+	const auto& o = *_schema;
+	const auto& n = *next;
+	std::unique_ptr<uint64_t[]> state(new uint64_t[n._state_words]());
+	std::unique_ptr<uint64_t[]> old_state = std::exchange(_state, std::move(state));
+	auto old_stamp = [&](size_t word) { return can_time(can_time::duration(int64_t(old_state[word]))); };
+
+	// the old group of every new one kept, the first of each name as in v2c_transcoder::set_env_var()
+	std::vector<uint32_t> kept_groups(n._groups.size(), v2c_schema::none);
+	for (uint32_t g = 0; g < n._groups.size(); ++g) {
+		auto old_it = std::find_if(o._groups.begin(), o._groups.end(),
+			[&](const auto& gd) { return gd.name == n._groups[g].name; });
+		if (old_it != o._groups.end() && old_it->freq == n._groups[g].freq)
+			kept_groups[g] = uint32_t(old_it - o._groups.begin());
+
+		if (kept_groups[g] != v2c_schema::none)
+			stamp_at(g, old_stamp(kept_groups[g]));
+		else if (_last_update_tp != can_time{})
+			stamp_at(g, _last_update_tp);
+	}
+
+	auto same_sigs = [&](const v2c_schema::message_def& a, const v2c_schema::message_def& b) {
+		return std::equal(
+			n._signals.begin() + a.first_sig, n._signals.begin() + a.first_sig + a.sigs,
+			o._signals.begin() + b.first_sig, o._signals.begin() + b.first_sig + b.sigs,
+			[](const auto& x, const auto& y) {
+				return x.sig == y.sig && x.val_type == y.val_type && (x.avg == v2c_schema::none) == (y.avg == v2c_schema::none);
+			}
+		);
+	};
+
+	std::unordered_set<uint64_t> kept_msgs;
+	for (const auto& [key, m] : n._message_idx) {
+		const auto& md = n._messages[m];
+		auto old_it = o._message_idx.find(key);
+		if (md.group == v2c_schema::none || old_it == o._message_idx.end())
+			continue;
+		const auto& old_md = o._messages[old_it->second];
+		if (kept_groups[md.group] != old_md.group || md.mux != old_md.mux || !same_sigs(md, old_md))
+			continue;
+
+		kept_msgs.insert(key);
+		_state[n._stamp_words + m] = old_state[o._stamp_words + old_it->second];
+		for (uint32_t i = 0; i < md.sigs; ++i) {
+			uint32_t avg = n._signals[md.first_sig + i].avg, old_avg = o._signals[old_md.first_sig + i].avg;
+			if (avg == v2c_schema::none)
+				continue;
+			_state[n._avg_words + 2 * size_t(avg)] = old_state[o._avg_words + 2 * size_t(old_avg)];
+			_state[n._avg_words + 2 * size_t(avg) + 1] = old_state[o._avg_words + 2 * size_t(old_avg) + 1];
+		}
+	}
+
+	// the last assembled values of the kept messages in the kept groups
+	for (uint32_t g = 0; g < n._groups.size(); ++g) {
+		if (kept_groups[g] == v2c_schema::none)
+			continue;
+		const auto& gd = n._groups[g];
+		const auto& old_gd = o._groups[kept_groups[g]];
+		for (uint32_t i = gd.first_slot; i < gd.first_slot + gd.slots; ++i) {
+			if (!kept_msgs.contains(n._slots[i].key))
+				continue;
+			auto first = o._slots.begin() + old_gd.first_slot, last = first + old_gd.slots;
+			auto old_it = std::find_if(first, last, [&](const auto& sd) {
+				return sd.key == n._slots[i].key && sd.mux == n._slots[i].mux;
+			});
+			if (old_it == last)
+				continue;
+			size_t old_slot = old_it - o._slots.begin();
+			_state[n._slot_words + 2 * i] = old_state[o._slot_words + 2 * old_slot];
+			_state[n._slot_words + 2 * i + 1] = old_state[o._slot_words + 2 * old_slot + 1];
+		}
+	}
+
+	if (_metrics) {
+		std::vector<std::unique_ptr<tx_group_metrics>> groups;
+		for (uint32_t g = 0; g < n._groups.size(); ++g) {
+			if (kept_groups[g] != v2c_schema::none)
+				groups.push_back(std::move(_metrics->groups[kept_groups[g]]));
+			else
+				groups.push_back(std::make_unique<tx_group_metrics>());
+		}
+		_metrics->groups = std::move(groups);
+	}
+
+	_schema = std::move(next);
+}
+
+void v2c_session::setup_timers(can_time first_stamp) {
+	using namespace std::chrono;
+
+	if (_last_update_tp != can_time{})
+		return;
+
+	_frame_packet.prepare(duration_cast<seconds>(first_stamp.time_since_epoch()).count(), _packet_reserve);
+	_last_update_tp = first_stamp;
+	for (size_t g = 0; g < _schema->_groups.size(); ++g)
+		stamp_at(g, first_stamp);
+}
+
+void v2c_session::count_packet(const frame_packet& fp) {
+	if (!_metrics)
+		return;
+	_metrics->packets_out.add();
+	_metrics->bytes_out.add(fp.byte_size());
+	_metrics->packet_bytes.record(fp.byte_size());
+}
+
+// Closes the windows of the groups that end by `up_to`, and publishes the ones in which
+// all their messages arrived into `fp`.
+
+void v2c_session::store_assembled(can_time up_to, frame_packet& fp) {
+	for (uint32_t g = 0; g < _schema->_groups.size(); ++g) {
+		const auto& gd = _schema->_groups[g];
+		if (stamp_at(g) + gd.freq > up_to)
+			continue;
+
+		tx_group_metrics* gm = _metrics ? _metrics->groups[g].get() : nullptr;
+		if (gm)
+			gm->windows.add();
+		if (all_collected(g)) {
+			metric_timer timer(gm ? &gm->publish_ns : nullptr, true);
+			publish(g, up_to, fp);
+			if (gm) {
+				gm->published.add();
+				gm->frames_out.add(gd.slots);
+			}
+		}
+		else if (gm)
+			gm->dropped.add();
+		stamp_at(g, up_to);
+	}
+}
+
+bool v2c_session::all_collected(uint32_t group) const {
+	using namespace std::chrono;
+	const auto& gd = _schema->_groups[group];
+	can_time origin = stamp_at(group);
+	for (size_t i = gd.first_slot; i < gd.first_slot + gd.slots; ++i) {
+		auto d = duration_cast<milliseconds>(stamp_at(_schema->_slot_words + 2 * i) - origin);
+		if (d < milliseconds(0) || d >= gd.freq)
+			return false;
+	}
+	return true;
+}
+
+void v2c_session::publish(uint32_t group, can_time tp, frame_packet& fp) {
+	// for messages with muxed signals, non-muxed signal values should be taken
+	// from the frame with the latest timestamp, indicated by can::use_non_muxed(cf, true)
+
+	const auto& s = *_schema;
+	const auto& gd = s._groups[group];
+
+	uint32_t order_buf[64];
+	std::vector<uint32_t> order_heap;
+	uint32_t* order = order_buf;
+	if (gd.slots > std::size(order_buf)) {
+		order_heap.resize(gd.slots);
+		order = order_heap.data();
+	}
+	for (uint32_t i = 0; i < gd.slots; ++i)
+		order[i] = gd.first_slot + i;
+
+	// primarily by buses and message_ids, secondarily by timestamp, descending, then in the order of the slots
+	std::sort(order, order + gd.slots, [&](uint32_t a, uint32_t b) {
+		if (s._slots[a].key != s._slots[b].key)
+			return s._slots[a].key < s._slots[b].key;
+		can_time stamp_a = stamp_at(s._slot_words + 2 * a), stamp_b = stamp_at(s._slot_words + 2 * b);
+		return stamp_a != stamp_b ? stamp_a > stamp_b : a < b;
+	});
+
+	uint64_t prev_key = 0;
+	for (uint32_t j = 0; j < gd.slots; ++j) {
+		uint32_t i = order[j];
+		uint64_t key = s._slots[i].key;
+		can_frame cf { 0 };
+		cf.can_id = canid_t(key);
+		cf.len = CAN_MAX_DLEN;
+		can::frame_bus(cf, uint8_t(key >> 32));
+		can::use_non_muxed(cf, prev_key != key);
+		prev_key = key;
+		auto raw_data = _state[s._slot_words + 2 * i + 1];
+		std::memcpy(cf.data, &raw_data, CAN_MAX_DLEN);
+		fp.append(millis_diff(tp, fp.utc()));
+		fp.append(cf);
+	}
+}
+
+template <typename T>
+static uint64_t assemble_last(const sig_layout& sig, uint64_t fd) {
+	sig_calc_type<T> val(sig.decode(fd));
+	return sig.encode(val.get_raw());
+}
+
+template <typename T>
+static uint64_t assemble_avg(const sig_layout& sig, uint64_t* sum, uint64_t fd) {
+	sig_calc_type<T> val(sig.decode(fd));
+	if (sum[1] != 0)
+		val = sig_calc_type<T>(sum[0]) + val;
+	sum[0] = val.get_raw();
+	++sum[1];
+	return sig.encode(val.idivround(sum[1]).get_raw());
+}
+
+// Assembles the frame into the record of its multiplexer value: LAST signals take the frame's
+// value, AVG signals the average of the frames since their group's window began.
+
+void v2c_session::assemble(uint32_t message, can_time stamp, can_frame frame) {
+	const auto& s = *_schema;
+	const auto& md = s._messages[message];
+	if (md.group == v2c_schema::none)
+		return;
+
+	const auto& gd = s._groups[md.group];
+	can_time origin = stamp_at(md.group);
+	can_time last_stamp = stamp_at(s._stamp_words + message);
+	bool within_interval = last_stamp >= origin && last_stamp < origin + gd.freq;
+
+	uint64_t clumped_val = 0;
+	uint64_t fd = std::bit_cast<uint64_t>(frame.data);
+	int64_t mux_val = md.mux.has_value() ? md.mux->decode(fd) : -1;
+
+	for (size_t i = md.first_sig; i < md.first_sig + md.sigs; ++i) {
+		const auto& sd = s._signals[i];
+		uint64_t* sum = sd.avg == v2c_schema::none ? nullptr : &_state[s._avg_words + 2 * size_t(sd.avg)];
+		if (sum && !within_interval)
+			sum[0] = sum[1] = 0;
+		if (!sd.sig.is_active(mux_val))
+			continue;
+
+		if (!sum) {
+			switch (sd.val_type) {
+				case i64: clumped_val |= assemble_last<int64_t>(sd.sig, fd); break;
+				case u64: clumped_val |= assemble_last<uint64_t>(sd.sig, fd); break;
+				case f32: clumped_val |= assemble_last<float>(sd.sig, fd); break;
+				case f64: clumped_val |= assemble_last<double>(sd.sig, fd); break;
+			}
+			continue;
+		}
+		switch (sd.val_type) {
+			case i64: clumped_val |= assemble_avg<int64_t>(sd.sig, sum, fd); break;
+			case u64: clumped_val |= assemble_avg<uint64_t>(sd.sig, sum, fd); break;
+			case f32: clumped_val |= assemble_avg<float>(sd.sig, sum, fd); break;
+			case f64: clumped_val |= assemble_avg<double>(sd.sig, sum, fd); break;
+		}
+	}
+
+	if (md.mux.has_value())
+		clumped_val |= md.mux->encode(fd);
+
+	for (size_t i = md.first_slot; i < md.first_slot + md.slots; ++i) {
+		if (s._slots[i].mux == mux_val) {
+			stamp_at(s._slot_words + 2 * i, stamp);
+			_state[s._slot_words + 2 * i + 1] = clumped_val;
+			break;
+		}
+	}
+
+	stamp_at(s._stamp_words + message, stamp);
+}
+
+void v2c_session::decode_vin(can_frame frame) {
+	const auto& s = *_schema;
+	uint64_t fd = std::bit_cast<uint64_t>(frame.data);
+	uint64_t frame_mux = s._vin_mux.has_value() ? s._vin_mux->decode(fd) : -1;
+	for (const auto& [sig, chidx] : s._vin_sigs) {
+		if (!sig.is_active(frame_mux))
+			continue;
+		_vin[chidx - 1] = char(sig.decode(fd));
+		_vin_bits |= (1 << (chidx - 1));
+	}
+}
+
+} // end namespace can
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+
+#include "can/frame_packet.h"
+#include "v2c/v2c_metrics.h"
+#include "v2c/v2c_transcoder.h"
+
+/*
+
+The transcoding path: the definitions compiled from the DBCs, shared, and the state of
+one transcoding, per vehicle or per v2c_transcoder.
+
+v2c_schema holds what transcoding needs from the DBCs (the groups, the records they
+publish, the layouts and aggregation of the signals), compiled once from a loaded
+transcoder into flat arrays and shared, read-only, by any number of threads. v2c_session
+is the state of one vehicle: the window of every group, the last assembled value of
+every message in a group, the running sums of the AVG signals, the timers, the VIN and
+the packet being filled. The state is one block of 64-bit words, laid out by the schema,
+so a session costs a few hundred bytes plus its packet for a DBC the size of the
+example's.
+
+A v2c_transcoder compiles the DBCs it loaded with its first transcode(), and transcodes
+with a session of its own, with metrics. A server transcoding for many vehicles with the
+same DBC compiles the schema once and runs a session without metrics per vehicle, so it
+keeps neither the DBC's names nor a copy of the definitions per vehicle. Records of the
+same message with the same timestamp, which differ only by their multiplexer value, are
+published in the order of the values.
+
+	auto schema = can::v2c_schema::compile(dbc_src);
+	can::v2c_session session(schema); // one per vehicle
+	auto fp = session.transcode(t, frame);
+
+*/
+
+namespace can {
+
+class v2c_schema {
+	static constexpr uint32_t none = uint32_t(-1);
+
+	struct group_def {
+		std::string name;
+		std::chrono::milliseconds freq;
+		uint32_t first_slot, slots;
+	};
+
+	// a message, or a multiplexer value of one, in a group's published records
+	struct slot_def {
+		uint64_t key; // bus_msg_key()
+		int64_t mux;
+	};
+
+	// an aggregated signal, see tr_message::make_agg_defs()
+	struct signal_def {
+		sig_layout sig;
+		val_type_t val_type;
+		uint32_t avg; // index of the running sum of an AVG signal, or none for LAST
+	};
+
+	struct message_def {
+		std::optional<tr_muxer> mux;
+		uint32_t group = none;
+		uint32_t first_slot = 0, slots = 0;
+		uint32_t first_sig = 0, sigs = 0;
+	};
+
+	std::chrono::milliseconds _publish_freq { 0 };
+	std::chrono::milliseconds _update_freq { 0 };
+
+	std::vector<group_def> _groups;
+	std::vector<slot_def> _slots;
+	std::vector<signal_def> _signals;  // the aggregated signals of every message, one run per message
+	std::vector<message_def> _messages;
+	std::unordered_map<uint64_t, uint32_t> _message_idx; // by bus_msg_key()
+
+	std::optional<uint64_t> _vin_key;
+	std::optional<tr_muxer> _vin_mux;
+	std::vector<std::pair<sig_layout, int>> _vin_sigs; // the signals of the VIN message, with their characters
+
+	// offsets into a session's state, in words
+	size_t _slot_words = 0, _stamp_words = 0, _avg_words = 0, _state_words = 0;
+
+	friend class v2c_session;
+	friend class v2c_sharded_transcoder;
+public:
+	// Compiles the DBCs a transcoder was loaded with.
+	static std::shared_ptr<const v2c_schema> compile(const v2c_transcoder& loaded);
+	// Compiles the groups [first_group, last_group) of the transcoder; the messages of the others are ungrouped.
+	static std::shared_ptr<const v2c_schema> compile(const v2c_transcoder& loaded, size_t first_group, size_t last_group);
+	// nullptr if the DBC doesn't parse
+	static std::shared_ptr<const v2c_schema> compile(std::string_view dbc_src);
+
+	size_t state_words() const { return _state_words; }
+	size_t byte_size() const;
+
+private:
+	// the 1-based position of the VIN character the signal holds, or 0
+	static int vin_char(std::string_view sig_name);
+};
+
+struct session_options {
+	bool metrics = false;      // count frames, packets and windows, see v2c_metrics.h
+	size_t packet_reserve = 0; // bytes reserved for every new packet
+};
+
+class v2c_session {
+	std::shared_ptr<const v2c_schema> _schema;
+
+	// group origins, then (stamp, value) of the slots, last stamps of the messages, (sum, samples) of the AVG signals
+	std::unique_ptr<uint64_t[]> _state;
+
+	can_time _last_update_tp;
+	frame_packet _frame_packet;
+	size_t _packet_reserve;
+
+	uint32_t _vin_bits = 0;
+	char _vin[17];
+
+	std::unique_ptr<v2c_metrics> _metrics; // with session_options::metrics
+
+	friend class v2c_sharded_transcoder;
+public:
+	explicit v2c_session(std::shared_ptr<const v2c_schema> schema, const session_options& opts = {});
+
+	frame_packet transcode(can_time stamp, can_frame frame, uint8_t bus = 0);
+	frame_packet flush();
+	std::string vin() const;
+	void reload(std::shared_ptr<const v2c_schema> next);
+
+	const v2c_schema& schema() const { return *_schema; }
+	// zeros without session_options::metrics
+	v2c_metrics_snapshot metrics_snapshot() const;
+	// the memory of the session alone, the schema is shared
+	size_t state_bytes() const;
+
+private:
+	can_time stamp_at(size_t word) const { return can_time(can_time::duration(int64_t(_state[word]))); }
+	void stamp_at(size_t word, can_time tp) { _state[word] = uint64_t(tp.time_since_epoch().count()); }
+
+	void setup_timers(can_time first_stamp);
+	void count_packet(const frame_packet& fp);
+	void store_assembled(can_time up_to, frame_packet& fp);
+	bool all_collected(uint32_t group) const;
+	void publish(uint32_t group, can_time tp, frame_packet& fp);
+	void assemble(uint32_t message, can_time stamp, can_frame frame);
+	void decode_vin(can_frame frame);
+};
+
+} // end namespace can
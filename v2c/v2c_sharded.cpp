@@ -0,0 +1,252 @@
+#include "v2c_sharded.h"
+
+namespace can {
+
+v2c_sharded_transcoder::v2c_sharded_transcoder(const sharded_options& opts) :
+	_opts(opts)
+{}
+
+v2c_sharded_transcoder::~v2c_sharded_transcoder() {
+	{
+		std::lock_guard lock(_job_lock);
+		_stop = true;
+	}
+	_job_cv.notify_all();
+}
+
+bool v2c_sharded_transcoder::load_dbc(std::string_view dbc_src, uint8_t bus) {
+	return _router.load_dbc(dbc_src, bus);
+}
+
+// Splits the groups into runs of about the same number of signals, one run per shard,
+// gives every shard a session on a schema of the groups of its run, and starts the workers
+// of the shards after the first.
+
+void v2c_sharded_transcoder::split() {
+	if (_split)
+		return;
+	_split = true;
+
+	const auto& groups = _router._tx_groups;
+	std::unordered_map<const tx_group*, size_t> group_idx;
+	for (size_t i = 0; i < groups.size(); ++i)
+		group_idx.emplace(groups[i].get(), i);
+
+	std::vector<size_t> weights(groups.size());
+	size_t total = 0;
+	for (const auto& bus_msgs : _router._msgs) {
+		for (const auto& [message_id, msg] : bus_msgs) {
+			if (!msg.grouped())
+				continue;
+			weights[group_idx[msg.group()]] += msg.signal_count();
+			total += msg.signal_count();
+		}
+	}
+
+	// the shard of every group, by the middle of its weight, so the runs are consecutive
+	size_t nshards = std::max(1u, _opts.shards);
+	std::vector<uint32_t> group_shard(groups.size());
+	size_t before = 0, used = 0, prev = nshards;
+	for (size_t i = 0; i < groups.size(); ++i) {
+		size_t s = total ? std::min(nshards - 1, (2 * before + weights[i]) * nshards / (2 * total)) : 0;
+		before += weights[i];
+		// shards left without groups are skipped
+		if (s != prev)
+			++used, prev = s;
+		group_shard[i] = uint32_t(used - 1);
+	}
+	used = std::max<size_t>(used, 1);
+
+	// the router's session, on the whole DBC, keeps the timers, the VIN and the packet
+	_router.session();
+	_shards.resize(used);
+	size_t first = 0;
+	for (uint32_t s = 0; s < used; ++s) {
+		size_t last = first;
+		while (last < groups.size() && group_shard[last] == s)
+			++last;
+		auto schema = v2c_schema::compile(_router, first, last);
+		first = last;
+
+		for (const auto& [key, m] : schema->_message_idx)
+			if (schema->_messages[m].group != v2c_schema::none)
+				_routes.emplace(key, msg_route{ s, m });
+		_shards[s].session = std::make_unique<v2c_session>(std::move(schema), session_options{ .metrics = true });
+	}
+
+	for (size_t s = 1; s < used; ++s)
+		_workers.emplace_back([this, s] { work(s); });
+}
+
+// Finds the ticks and packet boundaries of the batch as v2c_session::transcode() does, and
+// hands the grouped frames to their shards.
+
+void v2c_sharded_transcoder::route(std::span<const timed_frame> frames) {
+	using namespace std::chrono;
+
+	auto& r = *_router._session;
+	const auto& rs = *r._schema;
+	_ticks.clear();
+	_packet_ticks.clear();
+	_packet_utcs.assign(1, r._last_update_tp == can_time{} ? 0 : r._frame_packet.utc());
+	for (auto& sh : _shards)
+		sh.frames.clear();
+
+	for (const auto& [stamp, frame] : frames) {
+		r._metrics->frames_in.add();
+
+		if (r._last_update_tp == can_time{}) {
+			r.setup_timers(stamp);
+			for (auto& sh : _shards)
+				sh.session->setup_timers(stamp);
+			_packet_utcs[0] = r._frame_packet.utc();
+		}
+
+		if (rs._update_freq.count() && r._last_update_tp + rs._update_freq <= stamp) {
+			_ticks.push_back({ r._last_update_tp + rs._update_freq, uint32_t(_packet_utcs.size() - 1) });
+			while (r._last_update_tp + rs._update_freq <= stamp)
+				r._last_update_tp += rs._update_freq;
+		}
+
+		can_time frame_begin { seconds(_packet_utcs.back()) };
+		if (stamp < frame_begin || stamp >= frame_begin + rs._publish_freq) {
+			_packet_ticks.push_back(_ticks.size());
+			_packet_utcs.push_back(uint32_t(duration_cast<seconds>(stamp.time_since_epoch()).count()));
+		}
+
+		uint64_t key = bus_msg_key(frame_bus(frame), frame.can_id);
+		if (key == rs._vin_key)
+			r.decode_vin(frame);
+
+		if (auto route_it = _routes.find(key); route_it != _routes.end()) {
+			auto [s, m] = route_it->second;
+			_shards[s].frames.push_back({ uint32_t(_ticks.size()), m, stamp, frame });
+		}
+		else if (rs._message_idx.contains(key))
+			r._metrics->ungrouped_frames.add();
+		else r._metrics->unknown_frames.add();
+	}
+}
+
+// Assembles the frames of the shard and publishes its groups at every tick of the batch.
+
+void v2c_sharded_transcoder::assemble(shard& sh) {
+	sh.fragments.resize(_packet_utcs.size());
+	for (size_t p = 0; p < _packet_utcs.size(); ++p)
+		sh.fragments[p].prepare(_packet_utcs[p]);
+	sh.tick_bytes.resize(_ticks.size());
+
+	size_t next_tick = 0;
+	auto publish_up_to = [&](size_t tick) {
+		for (; next_tick < tick; ++next_tick) {
+			auto& fp = sh.fragments[_ticks[next_tick].packet];
+			size_t begin = fp.byte_size();
+			sh.session->store_assembled(_ticks[next_tick].up_to, fp);
+			sh.tick_bytes[next_tick] = { begin, fp.byte_size() };
+		}
+	};
+
+	for (const auto& sf : sh.frames) {
+		publish_up_to(sf.tick);
+		sh.session->assemble(sf.message, sf.stamp, sf.frame);
+	}
+	publish_up_to(_ticks.size());
+}
+
+// Appends the records of every tick to the router's packet, shard by shard, so in the order
+// of the groups, and hands over the packets as v2c_session::transcode() does.
+
+void v2c_sharded_transcoder::merge(std::vector<frame_packet>& packets) {
+	auto& r = *_router._session;
+	size_t t = 0;
+	for (size_t p = 0; p < _packet_utcs.size(); ++p) {
+		size_t last = p < _packet_ticks.size() ? _packet_ticks[p] : _ticks.size();
+		for (; t < last; ++t) {
+			for (const auto& sh : _shards) {
+				auto [begin, end] = sh.tick_bytes[t];
+				const uint8_t* records = sh.fragments[_ticks[t].packet].data_begin();
+				r._frame_packet.append(records + begin, records + end);
+			}
+		}
+
+		if (p == _packet_ticks.size())
+			break;
+		if (!r._frame_packet.empty()) {
+			auto& fp = packets.emplace_back(std::move(r._frame_packet));
+			r.count_packet(fp);
+		}
+		r._frame_packet.prepare(_packet_utcs[p + 1], r._packet_reserve);
+	}
+}
+
+void v2c_sharded_transcoder::transcode(std::span<const timed_frame> frames, std::vector<frame_packet>& packets) {
+	if (frames.empty())
+		return;
+
+	split();
+
+	auto start = std::chrono::steady_clock::now();
+	route(frames);
+	run(&v2c_sharded_transcoder::assemble);
+	merge(packets);
+
+	// every batch is timed, and recorded per frame like the frames of v2c_transcoder::transcode()
+	if constexpr (metrics_enabled) {
+		auto batch_ns = (std::chrono::steady_clock::now() - start) / std::chrono::nanoseconds(1);
+		_router._session->_metrics->transcode_ns.record(uint64_t(batch_ns) / frames.size());
+	}
+}
+
+// Runs the job on every shard, the first on the calling thread and the others on their
+// workers, and waits until all are done.
+
+void v2c_sharded_transcoder::run(void (v2c_sharded_transcoder::*job)(shard&)) {
+	{
+		std::lock_guard lock(_job_lock);
+		_job = job;
+		_busy = _workers.size();
+		++_jobs;
+	}
+	_job_cv.notify_all();
+
+	(this->*job)(_shards[0]);
+
+	std::unique_lock lock(_job_lock);
+	_done_cv.wait(lock, [this] { return _busy == 0; });
+}
+
+void v2c_sharded_transcoder::work(size_t s) {
+	uint64_t done = 0;
+	while (true) {
+		void (v2c_sharded_transcoder::*job)(shard&);
+		{
+			std::unique_lock lock(_job_lock);
+			_job_cv.wait(lock, [&] { return _stop || _jobs != done; });
+			if (_stop)
+				return;
+			job = _job;
+			done = _jobs;
+		}
+
+		(this->*job)(_shards[s]);
+
+		std::lock_guard lock(_job_lock);
+		if (--_busy == 0)
+			_done_cv.notify_one();
+	}
+}
+
+// The router's counters, with the metrics of the groups from their shards.
+
+v2c_metrics_snapshot v2c_sharded_transcoder::metrics_snapshot() const {
+	auto rv = _router.metrics_snapshot();
+	if (!_split)
+		return rv;
+	rv.groups.clear();
+	for (const auto& sh : _shards)
+		for (auto& group : sh.session->metrics_snapshot().groups)
+			rv.groups.push_back(std::move(group));
+	return rv;
+}
+
+} // end namespace can
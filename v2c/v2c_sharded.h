@@ -0,0 +1,124 @@
+#pragma once
+
+#include <span>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "can/frame_packet.h"
+#include "v2c/v2c_transcoder.h"
+#include "v2c/v2c_session.h"
+
+/*
+
+Transcodes on several cores. The message groups of the DBC are split into `shards`
+runs of consecutive groups, of about the same number of signals each, and every run
+is aggregated by its own v2c_session, on a schema of the run's groups, on its own thread.
+
+transcode() takes a batch of frames, in timestamp order, with their buses set by
+can::frame_bus(). The calling thread walks the batch once, as v2c_session::transcode()
+would, to find the update ticks and packet boundaries, and hands every grouped frame to
+the shard of its group. The shards then assemble their frames and publish their groups
+at every tick in parallel, each into its own fragment of the packet. Finally, the calling
+thread merges the fragments of every tick in the order of the groups, which is the order
+a single transcoder publishes them in, so the packets are byte-for-byte the same as
+those of a v2c_transcoder with the same DBCs.
+
+The threads are started with the first batch and kept until the transcoder is destroyed,
+the calling thread working on the first shard. A batch is the unit of work handed to the
+threads, so batches of thousands of frames, like those of the log readers, keep them busy.
+A batch is transcoded completely before transcode() returns, so packets are never held back.
+
+*/
+
+namespace can {
+
+struct sharded_options {
+	unsigned shards = std::max(1u, std::thread::hardware_concurrency());
+};
+
+class v2c_sharded_transcoder {
+	// a grouped frame, after `tick` ticks of the batch
+	struct shard_frame {
+		uint32_t tick;
+		uint32_t message; // in the shard's schema
+		can_time stamp;
+		can_frame frame;
+	};
+
+	struct msg_route {
+		uint32_t shard;
+		uint32_t message; // in the shard's schema
+	};
+
+	struct tick {
+		can_time up_to;
+		uint32_t packet; // index of the packet of the batch the tick publishes into
+	};
+
+	// the work of one shard in a batch
+	struct shard {
+		std::unique_ptr<v2c_session> session;
+		std::vector<shard_frame> frames;
+		std::vector<frame_packet> fragments; // one per packet of the batch
+		std::vector<std::pair<size_t, size_t>> tick_bytes; // the records of every tick in its fragment
+	};
+
+	sharded_options _opts;
+	v2c_transcoder _router; // the whole DBC, its session routes frames and keeps the timers and the packet
+	std::vector<shard> _shards;
+	std::unordered_map<uint64_t, msg_route> _routes; // by bus_msg_key(), for grouped messages
+	bool _split = false;
+
+	// the ticks and packet boundaries of the current batch
+	std::vector<tick> _ticks;
+	std::vector<uint32_t> _packet_utcs;
+	std::vector<size_t> _packet_ticks; // ticks before the packet's boundary
+
+	// the job run() hands to the workers, one per shard after the first
+	std::mutex _job_lock;
+	std::condition_variable _job_cv;
+	std::condition_variable _done_cv;
+	void (v2c_sharded_transcoder::*_job)(shard&) = nullptr;
+	uint64_t _jobs = 0; // jobs handed out so far, guarded by _job_lock
+	size_t _busy = 0; // workers still running the job, guarded by _job_lock
+	bool _stop = false; // guarded by _job_lock
+
+	std::vector<std::jthread> _workers; // last, so they're joined before the rest is destroyed
+
+public:
+	explicit v2c_sharded_transcoder(const sharded_options& opts = {});
+	~v2c_sharded_transcoder();
+
+	v2c_sharded_transcoder(const v2c_sharded_transcoder&) = delete;
+	v2c_sharded_transcoder& operator=(const v2c_sharded_transcoder&) = delete;
+
+	// Loads the DBC of CAN bus `bus`, see v2c_transcoder::load_dbc(). All DBCs have to be
+	// loaded before the first batch.
+	bool load_dbc(std::string_view dbc_src, uint8_t bus = 0);
+
+	// Transcodes the frames and appends the finished packets to `packets`.
+	void transcode(std::span<const timed_frame> frames, std::vector<frame_packet>& packets);
+	frame_packet flush() { return _router.flush(); }
+
+	std::string vin() const { return _router.vin(); }
+	size_t shards() const { return _shards.size(); } // the threads used, known from the first batch on
+
+	// The router's counters and the shards' groups. transcode_ns samples every batch, as the
+	// time it took divided by its frames.
+	v2c_metrics_snapshot metrics_snapshot() const;
+
+private:
+	void split();
+	void route(std::span<const timed_frame> frames);
+	void assemble(shard& sh);
+	void run(void (v2c_sharded_transcoder::*job)(shard&));
+	void work(size_t s);
+	void merge(std::vector<frame_packet>& packets);
+};
+
+} // end namespace can
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+/*
+
+Interned strings, for the names of signals and other DBC metadata that's only read
+while loading a DBC or reporting, never while transcoding.
+
+intern() stores every distinct string once and returns a 32-bit handle to it, so
+objects on the hot path hold 4 bytes instead of a std::string. interned() turns a
+handle of any table back into the string without locking: the high bits of a handle
+are its table's slot, the low bits the string's index in it.
+
+Each v2c_transcoder and decode_model interns into a table of its own, and the table
+is freed with it, so reloading DBCs releases the names of the old ones. A table only
+grows while it lives; its byte_size() is the string_bytes of the transcoder's
+footprint(). At most 1024 tables, of up to 4M strings each, live at a time.
+
+	can::string_table strings;
+	can::str_handle h = strings.intern("EngineSpeed");
+	std::string_view name = can::interned(h);
+
+*/
+
+namespace can {
+
+using str_handle = uint32_t;
+
+class string_table {
+	// a handle is the table's slot above index_bits, and the string's index below
+	static constexpr unsigned index_bits = 22;
+	static constexpr size_t max_strings = size_t(1) << index_bits;
+	static constexpr size_t max_tables = size_t(1) << (32 - index_bits);
+
+	// the live tables by slot; a freed slot is taken again last, after all others
+	static inline std::array<std::atomic<string_table*>, max_tables> _slots{};
+	static inline std::mutex _slots_lock;
+	static inline size_t _next_slot = 0;
+
+	// the views of chunk k, of 2^(k + first_bits) strings each, cover all indices
+	static constexpr unsigned first_bits = 10;
+	static constexpr size_t block_chars = 64 * 1024;
+
+	size_t _slot;
+	std::array<std::unique_ptr<std::string_view[]>, index_bits + 1 - first_bits> _chunks;
+	std::vector<std::unique_ptr<char[]>> _blocks;
+	char* _block = nullptr; // the block strings are added to
+	size_t _block_free = 0;
+	size_t _block_bytes = 0;
+	size_t _size = 0;
+
+	// the handles, hashed and compared by their strings, to find a string's handle
+	struct handle_hash {
+		using is_transparent = void;
+		const string_table* table;
+		size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>{}(s); }
+		size_t operator()(str_handle h) const noexcept { return (*this)(table->str(h)); }
+	};
+	struct handle_eq {
+		using is_transparent = void;
+		const string_table* table;
+		std::string_view str(std::string_view s) const { return s; }
+		std::string_view str(str_handle h) const { return table->str(h); }
+		bool operator()(auto a, auto b) const { return str(a) == str(b); }
+	};
+	std::unordered_set<str_handle, handle_hash, handle_eq> _handles { 0, handle_hash{ this }, handle_eq{ this } };
+	mutable std::shared_mutex _lock;
+
+public:
+	string_table() {
+		std::lock_guard lock(_slots_lock);
+		for (size_t i = 0; i < max_tables; ++i) {
+			size_t slot = (_next_slot + i) % max_tables;
+			if (_slots[slot].load(std::memory_order_relaxed))
+				continue;
+			_slot = slot;
+			_next_slot = slot + 1;
+			_slots[slot].store(this, std::memory_order_release);
+			return;
+		}
+		throw std::length_error("string_table: too many tables");
+	}
+
+	~string_table() {
+		std::lock_guard lock(_slots_lock);
+		_slots[_slot].store(nullptr, std::memory_order_relaxed);
+	}
+
+	string_table(const string_table&) = delete;
+	string_table& operator=(const string_table&) = delete;
+
+	// The table of a handle, while it lives.
+	static const string_table& of(str_handle h) {
+		return *_slots[h >> index_bits].load(std::memory_order_acquire);
+	}
+
+	str_handle intern(std::string_view s) {
+		{
+			std::shared_lock lock(_lock);
+			if (auto h_it = _handles.find(s); h_it != _handles.end())
+				return *h_it;
+		}
+
+		std::lock_guard lock(_lock);
+		if (auto h_it = _handles.find(s); h_it != _handles.end())
+			return *h_it;
+
+		if (_size == max_strings)
+			throw std::length_error("string_table: too many strings");
+		std::string_view stored = store(s);
+		auto [chunk, idx] = locate(_size);
+		auto h = str_handle((_slot << index_bits) | _size++);
+		if (!_chunks[chunk])
+			_chunks[chunk] = std::make_unique<std::string_view[]>(size_t(1) << (chunk + first_bits));
+		_chunks[chunk][idx] = stored;
+		_handles.insert(h);
+		return h;
+	}
+
+	// Handles are only passed on after intern() returns, so their views are visible to any
+	// thread that got one.
+	std::string_view str(str_handle h) const {
+		auto [chunk, idx] = locate(h & (max_strings - 1));
+		return _chunks[chunk][idx];
+	}
+
+	size_t size() const {
+		std::shared_lock lock(_lock);
+		return _size;
+	}
+
+	// heap bytes of the strings, their views and the lookup map
+	size_t byte_size() const {
+		std::shared_lock lock(_lock);
+		size_t rv = _block_bytes + _blocks.capacity() * sizeof(_blocks[0]);
+		for (size_t k = 0; k < _chunks.size() && _chunks[k]; ++k)
+			rv += (size_t(1) << (k + first_bits)) * sizeof(std::string_view);
+		rv += _handles.bucket_count() * sizeof(void*);
+		rv += _handles.size() * 2 * sizeof(void*);
+		return rv;
+	}
+
+private:
+	static std::pair<size_t, size_t> locate(size_t index) {
+		size_t biased = index + (size_t(1) << first_bits);
+		size_t chunk = std::bit_width(biased) - 1 - first_bits;
+		return { chunk, biased - (size_t(1) << (chunk + first_bits)) };
+	}
+
+	std::string_view store(std::string_view s) {
+		if (s.empty())
+			return {};
+		char* p;
+		if (s.size() > block_chars / 4) {
+			// a block of its own, the current one keeps its free space
+			_blocks.push_back(std::make_unique<char[]>(s.size()));
+			_block_bytes += s.size();
+			p = _blocks.back().get();
+		}
+		else {
+			if (s.size() > _block_free) {
+				_blocks.push_back(std::make_unique<char[]>(block_chars));
+				_block_bytes += block_chars;
+				_block = _blocks.back().get();
+				_block_free = block_chars;
+			}
+			p = _block + (block_chars - _block_free);
+			_block_free -= s.size();
+		}
+		std::copy(s.begin(), s.end(), p);
+		return { p, s.size() };
+	}
+};
+
+inline std::string_view interned(str_handle h) {
+	return string_table::of(h).str(h);
+}
+
+} // end namespace can
@@ -1,133 +1,22 @@
 #include <numeric>
 #include <unordered_map>
 #include <chrono>
-#include <bit>
 
 #include "can/can_codec.h"
 #include "v2c_transcoder.h"
+#include "v2c_session.h"
 
 namespace can {
 
-template <typename T>
-class sig_last {
-	const tr_signal _sig;
-	sig_calc_type<T> _val { 0 };
-public:
-	sig_last(const tr_signal sig) : _sig(sig) {}
-
-	friend uint64_t tag_invoke(assemble_cpo, sig_last& self, uint64_t mux_val, uint64_t fd) {
-		if (!self._sig.is_active(mux_val))
-			return 0;
-
-		sig_calc_type<T> val(self._sig.decode(fd));
-		self._val = val;
-		return self._sig.encode(val.get_raw());
-	}
-
-	friend void tag_invoke(reset_cpo, sig_last&) { }
-};
-
-template <typename T>
-class sig_avg {
-	const tr_signal _sig;
-	sig_calc_type<T> _val { 0 };
-	uint64_t _num_samples { 0 };
-public:
-	sig_avg(const tr_signal sig) : _sig(sig) {}
-
-	friend uint64_t tag_invoke(assemble_cpo, sig_avg& self, uint64_t mux_val, uint64_t fd) {
-		if (!self._sig.is_active(mux_val))
-			return 0;
-
-		sig_calc_type<T> val(self._sig.decode(fd));
-		self._val = (self._num_samples == 0) ? val : self._val + val;
-		++self._num_samples;
-
-		return self._sig.encode(self._val.idivround(self._num_samples).get_raw());
-	}
-
-	friend void tag_invoke(reset_cpo, sig_avg& self) {
-		self._val = 0;
-		self._num_samples = 0;
-	}
-};
-
-static int32_t millis_diff(can_time tp, uint32_t utc) {
-	using namespace std::chrono;
-	return duration_cast<milliseconds>(tp - can_time(seconds(utc))).count();
-}
-
-void tx_group::try_publish(can_time up_to, frame_packet& fp) {
-	if (_group_origin + _assemble_freq <= up_to) {
-		if (all_collected())
-			publish(up_to, fp);
-		_group_origin = up_to;
-	}
-}
-
-void tx_group::publish(can_time tp, frame_packet& fp) {
-	// for messages with muxed signals, non-muxed signal values should be taken 
-	// from the frame with the latest timestamp, indicated by can::use_non_muxed(cf, true)
-
-	std::sort(_msg_clumps.begin(), _msg_clumps.end(), [](const auto& a, const auto& b) {
-		if (a.message_id != b.message_id) // primarily by message_ids
-			return a.message_id < b.message_id;
-		return a.stamp > b.stamp; // secondarily by timestamp, descending
-	});
-
-	int64_t prev_id = 0;
-	for (const auto& smsg : _msg_clumps) {
-		can_frame cf { 0 };
-		cf.can_id = smsg.message_id;
-		cf.len = CAN_MAX_DLEN;
-		can::use_non_muxed(cf, prev_id != cf.can_id);
-		prev_id = cf.can_id;
-		auto raw_data = smsg.mdata;
-		std::memcpy(cf.data, &raw_data, CAN_MAX_DLEN);
-		fp.append(millis_diff(tp, fp.utc()));
-		fp.append(cf);
-	}
-}
-
-bool tx_group::all_collected() const {
-	using namespace std::chrono;
-	for (const auto& smsg : _msg_clumps) {
-		auto d = duration_cast<milliseconds>(smsg.stamp - _group_origin);
-		if (d < milliseconds(0) || d >= _assemble_freq)
-			return false;
-	}
-	return true;
-}
-
-// used only to assemble messages
-
-void tx_group::assign(canid_t message_id, int64_t message_mux) {
-	_msg_clumps.push_back({ .message_id = message_id, .message_mux = message_mux });
-}
-
-bool tx_group::within_interval(can_time stamp) const {
-	return stamp >= _group_origin && stamp < _group_origin + _assemble_freq;
-}
-
-void tx_group::add_clumped(can_time stamp, canid_t message_id, int64_t message_mux, uint64_t cval) {
-	for (auto& smsg : _msg_clumps) {
-		if (smsg.message_id == message_id && smsg.message_mux == message_mux) {
-			smsg.stamp = stamp; smsg.mdata = cval;
-			break;
-		}
-	}
+void tx_group::footprint(v2c_footprint& rv) const {
+	++rv.groups;
+	rv.group_bytes += sizeof(tx_group) + _slots.capacity() * sizeof(slot);
+	if (_name.capacity() > std::string().capacity())
+		rv.group_bytes += _name.capacity() + 1;
 }
 
-template <template <typename> typename sig_agg>
-static sig_asm make_sig_agg(const tr_signal& sig) {
-	switch (sig.value_type()) {
-		case i64: return sig_asm(sig_agg<int64_t>(sig));
-		case u64: return sig_asm(sig_agg<uint64_t>(sig));
-		case f32: return sig_asm(sig_agg<float>(sig));
-		case f64: return sig_asm(sig_agg<double>(sig));
-	}
-	fprintf(stderr, "Signal %s doesn't have a valid value_type\n", sig.name().c_str());
-	return { sig_avg<int64_t>(sig) };
+void tx_group::assign(uint8_t bus, canid_t message_id, int64_t message_mux) {
+	_slots.push_back({ .message_id = message_id, .bus = bus, .message_mux = message_mux });
 }
 
 std::vector<uint64_t> tr_message::distinct_mux_vals() const {
@@ -144,73 +33,74 @@ std::vector<uint64_t> tr_message::distinct_mux_vals() const {
 	return mux_vals;
 }
 
-void tr_message::assign_group(tx_group* txg, uint32_t message_id) {
+void tr_message::assign_group(tx_group* txg, uint32_t message_id, uint8_t bus) {
 	_tx_group = txg;
-	make_sig_assemblers();
+	make_agg_defs();
 
 	if (_mux.has_value())
 		for (const auto mux_val : distinct_mux_vals())
-			_tx_group->assign(message_id, mux_val);
+			_tx_group->assign(bus, message_id, mux_val);
 	else
-		_tx_group->assign(message_id, -1);
-}
-
-void tr_message::assemble(can_time stamp, can_frame frame) {
-	if (!_tx_group) return;
-
-	if (!_tx_group->within_interval(_last_stamp))
-		reset_sig_asms();
-
-	uint64_t clumped_val = 0;
-	uint64_t fd = std::bit_cast<uint64_t>(frame.data);
-	int64_t mux_val = _mux.has_value() ? _mux->decode(fd) : -1;
-
-	for (auto& sc : _sig_asms)
-		clumped_val |= sig_assemble(sc, mux_val, fd);
-
-	if (_mux.has_value())
-		clumped_val |= _mux->encode(fd);
-
-	_tx_group->add_clumped(stamp, frame.can_id, mux_val, clumped_val);
-
-	_last_stamp = stamp;
+		_tx_group->assign(bus, message_id, -1);
 }
 
-void tr_message::make_sig_assemblers() {
-	for (const tr_signal& sig : _signals) {
+void tr_message::make_agg_defs() {
+	for (size_t i = 0; i < _signals.size(); ++i) {
+		const tr_signal& sig = _signals[i];
 		std::string_view atype = sig.agg_type();
-		sig_asm sasm;
-
-		if (atype == "LAST")
-			sasm = make_sig_agg<sig_last>(sig);
-		else if (atype == "AVG")
-			sasm = make_sig_agg<sig_avg>(sig);
-		else continue;
-
-		_sig_asms.emplace_back(std::move(sasm));
+		if (atype != "LAST" && atype != "AVG")
+			continue;
+
+		val_type_t vt = sig.value_type();
+		if (vt != i64 && vt != u64 && vt != f32 && vt != f64) {
+			// averaged as an integer
+			fprintf(stderr, "Signal %s doesn't have a valid value_type\n", std::string(sig.name()).c_str());
+			_agg_defs.push_back({ uint32_t(i), true, i64 });
+			continue;
+		}
+		_agg_defs.push_back({ uint32_t(i), atype == "AVG", vt });
 	}
 }
 
-void tr_message::reset_sig_asms() {
-	for (auto& sc : _sig_asms)
-		sig_reset(sc);
-}
+tr_signal* tr_message::find_signal(std::string_view sig_name) {
+	if (_signals.size() <= linear_search_max) {
+		auto sig_it = std::find_if(_signals.begin(), _signals.end(), [&](const auto& s) { return s.name() == sig_name; });
+		return sig_it == _signals.end() ? nullptr : &(*sig_it);
+	}
 
-tr_signal* tr_message::find_signal(const std::string& sig_name) {
-	auto sig_it = std::find_if(_signals.begin(), _signals.end(), [&](const auto& s) { return s.name() == sig_name; });
-	return sig_it == _signals.end() ? nullptr : &(*sig_it);
+	std::hash<std::string_view> hash;
+	_sig_index.reserve(_signals.size());
+	for (size_t i = _sig_index.size(); i < _signals.size(); ++i)
+		_sig_index.emplace(hash(_signals[i].name()), i);
+
+	// the first of equally named signals, as above
+	tr_signal* rv = nullptr;
+	auto [first, last] = _sig_index.equal_range(hash(sig_name));
+	for (auto idx_it = first; idx_it != last; ++idx_it) {
+		auto& sig = _signals[idx_it->second];
+		if (sig.name() == sig_name && (!rv || &sig < rv))
+			rv = &sig;
+	}
+	return rv;
 }
 
-void tr_message::sig_agg_type(const std::string& sig_name, const std::string& agg_type) {
+void tr_message::sig_agg_type(std::string_view sig_name, str_handle agg_type) {
 	if (auto sig = find_signal(sig_name); sig)
 		sig->agg_type(agg_type);
 }
 
-void tr_message::sig_val_type(const std::string& sig_name, unsigned sig_ext_val_type) {
+void tr_message::sig_val_type(std::string_view sig_name, unsigned sig_ext_val_type) {
 	if (auto sig = find_signal(sig_name); sig)
 		sig->value_type(sig_ext_val_type);
 }
 
+void tr_message::footprint(v2c_footprint& rv) const {
+	rv.signals += _signals.size();
+	rv.signal_bytes += _signals.capacity() * sizeof(tr_signal) + _agg_defs.capacity() * sizeof(agg_def);
+	rv.message_bytes += _sig_index.bucket_count() * sizeof(void*) +
+		_sig_index.size() * (sizeof(std::pair<const size_t, size_t>) + sizeof(void*));
+}
+
 void tr_message::add_signal(tr_signal sig) {
 	_signals.push_back(std::move(sig));
 }
@@ -219,94 +109,151 @@ void tr_message::add_muxer(tr_muxer mux) {
 	_mux = std::move(mux);
 }
 
-bool vin_assembler::decode_some(const can::tr_message& msg, can_frame frame) {
-	if (frame.can_id != _vin_msg_id)
-		return false;
-	auto old_bits = _cbits;
-	uint64_t fd = std::bit_cast<uint64_t>(frame.data);
-	for (const auto& sig : msg.signals(fd)) {
-		int chidx = vin_char(sig.name());
-		if (chidx == 0) continue;
-		_vin[chidx - 1] = char(sig.decode(fd));
-		_cbits |= (1 << (chidx - 1));
-	}
-	return _cbits != old_bits;
+v2c_transcoder::v2c_transcoder() = default;
+v2c_transcoder::~v2c_transcoder() = default;
+v2c_transcoder::v2c_transcoder(v2c_transcoder&&) = default;
+v2c_transcoder& v2c_transcoder::operator=(v2c_transcoder&&) = default;
+
+// The session transcoding with the loaded DBCs, compiled by the first call.
+
+v2c_session& v2c_transcoder::session() {
+	if (_session)
+		return *_session;
+
+	// the DBC is loaded, the signal lookups are over
+	for (auto& bus_msgs : _msgs)
+		for (auto& [message_id, msg] : bus_msgs)
+			msg.drop_index();
+
+	_session = std::make_unique<v2c_session>(v2c_schema::compile(*this), session_options{ .metrics = true, .packet_reserve = 32 * 1024 });
+	return *_session;
 }
 
-int vin_assembler::vin_char(std::string_view sig_name) {
-	if (sig_name.find_first_of("VIN") != 0) return 0;
-	auto rb = sig_name.rbegin();
-	while (rb != sig_name.rend() && std::isdigit(*rb)) ++rb;
-	return std::stoi(sig_name.data() + std::distance(rb, sig_name.rend()));
+frame_packet v2c_transcoder::transcode(can_time stamp, can_frame frame, uint8_t bus) {
+	return session().transcode(stamp, frame, bus);
 }
 
-frame_packet v2c_transcoder::transcode(can_time stamp, can_frame frame) {
-	using namespace std::chrono;
+// hands over the frames published so far, e.g. at the end of a recorded trace
 
-	setup_timers(stamp);
+frame_packet v2c_transcoder::flush() {
+	return _session ? _session->flush() : frame_packet {};
+}
 
-	if (_last_update_tp + _update_freq <= stamp) {
-		store_assembled(_last_update_tp + _update_freq);
-		while (_last_update_tp + _update_freq <= stamp)
-			_last_update_tp += _update_freq;
+std::string v2c_transcoder::vin() const {
+	return _session ? _session->vin() : std::string {};
+}
+
+v2c_footprint v2c_transcoder::footprint() const {
+	v2c_footprint rv;
+	rv.message_bytes = sizeof(v2c_transcoder) + _msgs.capacity() * sizeof(_msgs[0]);
+	for (const auto& msgs : _msgs) {
+		rv.messages += msgs.size();
+		rv.message_bytes += msgs.bucket_count() * sizeof(void*) +
+			msgs.size() * (sizeof(std::pair<const canid_t, tr_message>) + sizeof(void*));
+		for (const auto& [message_id, msg] : msgs)
+			msg.footprint(rv);
+	}
+	rv.group_bytes = _tx_groups.capacity() * sizeof(_tx_groups[0]) +
+		_tx_groups_by_name.bucket_count() * sizeof(void*) +
+		_tx_groups_by_name.size() * (sizeof(std::pair<const std::string_view, tx_group*>) + 2 * sizeof(void*));
+	for (const auto& txg : _tx_groups)
+		txg->footprint(rv);
+	if (_session) {
+		rv.schema_bytes = _session->schema().byte_size();
+		rv.state_bytes = _session->state_bytes();
 	}
+	rv.string_bytes = _strings->byte_size();
+	return rv;
+}
 
-	can_time frame_begin { seconds(_frame_packet.utc()) };
-	can_time frame_end = frame_begin + _publish_freq;
+// The groups are listed, with zeros, before the first transcode() too.
 
-	frame_packet rv {};
+v2c_metrics_snapshot v2c_transcoder::metrics_snapshot() const {
+	if (_session)
+		return _session->metrics_snapshot();
 
-	if (stamp < frame_begin || stamp >= frame_end) {
-		if (!_frame_packet.empty())
-			rv = std::move(_frame_packet);
-		_frame_packet.prepare(duration_cast<seconds>(stamp.time_since_epoch()).count());
-	}
+	v2c_metrics_snapshot rv;
+	for (const auto& txg : _tx_groups)
+		rv.groups.push_back({ .name = std::string(txg->name()) });
+	return rv;
+}
 
-	auto mi = _msgs.find(frame.can_id);
-	if (mi != _msgs.end()) {
-		_vin.decode_some(mi->second, frame);
-		mi->second.assemble(stamp, frame);
-	}
+// Builds the transcoder anew from the DBC of bus 0 and reloads it, see below. Leaves it as it was if
+// the DBC doesn't parse, or if the transcoder has several buses, which would be dropped.
 
-	return rv;
+bool v2c_transcoder::reload(std::string_view dbc_src) {
+	if (_msgs.size() > 1)
+		return false;
+	return reload(std::span(&dbc_src, 1));
 }
 
-void v2c_transcoder::setup_timers(can_time first_stamp) {
-	using namespace std::chrono;
+// Builds the transcoder anew from one DBC per bus, `dbc_srcs[bus]`, and reloads it. Buses without
+// a DBC are dropped. Leaves it as it was if any of the DBCs doesn't parse.
+
+bool v2c_transcoder::reload(std::span<const std::string_view> dbc_srcs) {
+	v2c_transcoder next;
+	for (size_t bus = 0; bus < dbc_srcs.size(); ++bus)
+		if (!next.load_dbc(dbc_srcs[bus], uint8_t(bus)))
+			return false;
+	reload(std::move(next));
+	return true;
+}
 
-	if (_last_update_tp != can_time{})
+// Switches to the messages, signals and groups of `next`, a transcoder freshly built from a new
+// DBC, between two transcode() calls. Once transcoding, the session is kept and switched to the
+// schema compiled from `next`, see v2c_session::reload().
+
+void v2c_transcoder::reload(v2c_transcoder&& next) {
+	auto session = std::move(_session);
+	*this = std::move(next);
+	if (!session)
 		return;
 
-	_frame_packet.prepare(duration_cast<seconds>(first_stamp.time_since_epoch()).count());
-	_last_update_tp = first_stamp;
+	for (auto& bus_msgs : _msgs)
+		for (auto& [message_id, msg] : bus_msgs)
+			msg.drop_index();
 
-	for (auto& txg : _tx_groups)
-		txg->time_begin(_last_update_tp);
+	session->reload(v2c_schema::compile(*this));
+	_session = std::move(session);
 }
 
-void v2c_transcoder::store_assembled(can_time up_to) {
-	for (auto& txg : _tx_groups)
-		txg->try_publish(up_to, _frame_packet);
+// helper methods for dbc_parser, to initialize the transcoder structures:
+
+// the transcoder is passed to the parser by reference, which the interpreter stores inline
+static_assert(mireo::stored_inline_v<interpreter, std::reference_wrapper<v2c_transcoder>>);
+
+// Loads the DBC of CAN bus `bus`. Message groups defined by the DBCs of several buses are
+// shared, so a group can span buses. parse_dbc(dbc_src, std::ref(transcoder)) loads bus 0.
+
+bool v2c_transcoder::load_dbc(std::string_view dbc_src, uint8_t bus) {
+	_loading_bus = bus;
+	bool parsed = parse_dbc(dbc_src, std::ref(*this), handled_sections<v2c_transcoder>);
+	_loading_bus = 0;
+	return parsed;
 }
 
-// helper methods for dbc_parser, to initialize the transcoder structures:
+tr_message* v2c_transcoder::find_message(uint8_t bus, canid_t message_id) {
+	if (bus >= _msgs.size())
+		return nullptr;
+	auto msg_it = _msgs[bus].find(message_id);
+	return msg_it == _msgs[bus].end() ? nullptr : &(msg_it->second);
+}
+
+// the messages of the bus being loaded
 
 tr_message* v2c_transcoder::find_message(canid_t message_id) {
-	auto msg_it = _msgs.find(message_id);
-	return msg_it == _msgs.end() ? nullptr : &(msg_it->second);
+	return find_message(_loading_bus, message_id);
 }
 
 void v2c_transcoder::assign_tx_group(
-	const std::string& object_type, unsigned message_id, const std::string& tx_group
+	std::string_view object_type, unsigned message_id, std::string_view tx_group
 ) {
-	auto grp_it = std::find_if(_tx_groups.begin(), _tx_groups.end(),
-		[&](const auto& g) { return g->name() == tx_group; });
-
-	if (grp_it == _tx_groups.end())
+	auto grp_it = _tx_groups_by_name.find(tx_group);
+	if (grp_it == _tx_groups_by_name.end())
 		return;
 
 	if (auto msg_ptr = find_message(message_id); msg_ptr)
-		msg_ptr->assign_group(grp_it->get(), message_id);
+		msg_ptr->assign_group(grp_it->second, message_id, _loading_bus);
 }
 
 void v2c_transcoder::add_signal(canid_t message_id, tr_signal sig) {
@@ -321,18 +268,31 @@ void v2c_transcoder::add_muxer(canid_t message_id, tr_muxer mux) {
 
 void v2c_transcoder::add_message(canid_t message_id, std::string_view message_name) {
 	if (message_name == "VIN")
-		_vin.vin_message_id(message_id);
-	_msgs.try_emplace(message_id);
+		_vin_key = bus_msg_key(_loading_bus, message_id);
+	if (_msgs.size() <= _loading_bus)
+		_msgs.resize(_loading_bus + 1);
+	if (auto [msg_it, inserted] = _msgs[_loading_bus].try_emplace(message_id); inserted)
+		msg_it->second.reserve_signals(_sigs_per_msg);
+}
+
+void v2c_transcoder::reserve(size_t messages, size_t signals) {
+	if (_msgs.size() <= _loading_bus)
+		_msgs.resize(_loading_bus + 1);
+	_msgs[_loading_bus].reserve(messages);
+	_sigs_per_msg = messages ? (signals + messages - 1) / messages : 0;
 }
 
-void v2c_transcoder::set_env_var(const std::string& name, int64_t ev_value) {
+void v2c_transcoder::set_env_var(std::string_view name, int64_t ev_value) {
 	using namespace std::chrono;
 
 	if (name == "V2CTxTime") {
 		_publish_freq = milliseconds(ev_value);
 	}
 	else if (name.ends_with("GroupTxFreq")) {
+		if (_tx_groups_by_name.contains(name))
+			return; // defined by the DBC of another bus as well, the group is shared
 		_tx_groups.emplace_back(new tx_group(name, ev_value));
+		_tx_groups_by_name.try_emplace(_tx_groups.back()->name(), _tx_groups.back().get());
 
 		auto ufreq = _update_freq / 1ms;
 		ufreq = ufreq ? std::gcd(ufreq, ev_value) : ev_value;
@@ -340,14 +300,14 @@ void v2c_transcoder::set_env_var(const std::string& name, int64_t ev_value) {
 	}
 }
 
-void v2c_transcoder::set_sig_val_type(canid_t message_id, const std::string& sig_name, unsigned sig_ext_val_type) {
+void v2c_transcoder::set_sig_val_type(canid_t message_id, std::string_view sig_name, unsigned sig_ext_val_type) {
 	if (auto msg_ptr = find_message(message_id); msg_ptr)
 		msg_ptr->sig_val_type(sig_name, sig_ext_val_type);
 }
 
-void v2c_transcoder::set_sig_agg_type(canid_t message_id, const std::string& sig_name, const std::string& agg_type) {
+void v2c_transcoder::set_sig_agg_type(canid_t message_id, std::string_view sig_name, std::string_view agg_type) {
 	if (auto msg_ptr = find_message(message_id); msg_ptr)
-		msg_ptr->sig_agg_type(sig_name, agg_type);
+		msg_ptr->sig_agg_type(sig_name, _strings->intern(agg_type));
 }
 
 } // end namespace can
@@ -3,76 +3,92 @@
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
+#include <span>
 #include <ranges>
 #include <algorithm>
 #include <utility>
+#include <memory>
+#include <optional>
 
-#include "any/any.h"
 #include "can/can_codec.h"
 #include "can/frame_packet.h"
 #include "dbc/dbc_parser.h"
 #include "dbc/parser_template.h"
+#include "v2c/v2c_metrics.h"
+#include "v2c/v2c_strings.h"
 
 namespace can {
 
-constexpr struct assemble_cpo {
-	using type_erased_signature_t = uint64_t(mireo::this_&, int64_t, uint64_t);
+// Where a signal is in a frame, and in which frames: all that assembling it needs. 16 bytes,
+// apart from the signal's name and other metadata, which are only needed while loading.
+class sig_layout {
+	sig_codec _codec;
+	bool _muxed;
+	uint32_t _mux_val; // DBC multiplexer switch values are unsigned
+public:
+	sig_layout(sig_codec codec, std::optional<int64_t> mux_val) :
+		_codec(codec), _muxed(mux_val.has_value()), _mux_val(uint32_t(mux_val.value_or(0)))
+	{}
 
-	template<typename T> requires mireo::tag_invocable<assemble_cpo, T&, uint64_t, uint64_t>
-	uint64_t operator()(T& x, int64_t mux_val, uint64_t fd) const {
-		return mireo::tag_invoke(*this, x, mux_val, fd);
+	const sig_codec& codec() const { return _codec; }
+	std::optional<int64_t> mux_val() const {
+		return _muxed ? std::optional<int64_t>(_mux_val) : std::nullopt;
 	}
-} sig_assemble;
 
-constexpr struct reset_cpo {
-	using type_erased_signature_t = void(mireo::this_&);
+	bool is_active(uint64_t frame_mux_val) const {
+		return !_muxed || _mux_val == frame_mux_val;
+	}
 
-	template<typename T> requires mireo::tag_invocable<reset_cpo, T&>
-	void operator()(T& x) const {
-		return mireo::tag_invoke(*this, x);
+	uint64_t decode(uint64_t data) const {
+		return _codec.decode(data);
 	}
-} sig_reset;
 
-using sig_asm = mireo::any<sig_assemble, sig_reset>;
+	uint64_t encode(uint64_t raw) const {
+		uint64_t rv = 0;
+		_codec(raw, (void*)&rv);
+		return rv;
+	}
 
-class tr_signal {
-	std::string _name;
-	sig_codec _codec;
+	bool operator==(const sig_layout&) const = default;
+};
 
-	std::string _agg_type = "LAST";
+class tr_signal {
+	sig_layout _layout;
+	str_handle _name; // interned, see v2c_strings.h
+	str_handle _agg_type;
 	val_type_t _val_type = i64;
-	std::optional<int64_t> _mux_val; 
 public:
-	tr_signal(std::string name, sig_codec codec, std::optional<int64_t> mux_val)
-		: _name(std::move(name)), _codec(codec), _mux_val(mux_val)
+	tr_signal(string_table& strings, std::string_view name, sig_codec codec, std::optional<int64_t> mux_val)
+		: _layout(codec, mux_val), _name(strings.intern(name)), _agg_type(strings.intern("LAST"))
 	{}
 
-	const std::string& name() const { return _name; }
-	std::optional<int64_t> mux_val() const { return _mux_val; }
+	std::string_view name() const { return interned(_name); }
+	const sig_layout& layout() const { return _layout; }
+	std::optional<int64_t> mux_val() const { return _layout.mux_val(); }
 
 	bool is_active(uint64_t frame_mux_val) const {
-		return !_mux_val || _mux_val == frame_mux_val;
+		return _layout.is_active(frame_mux_val);
 	}
 	
-	std::string_view agg_type() const { return _agg_type; }
-	void agg_type(const std::string& agg_type) { _agg_type = agg_type; }
+	std::string_view agg_type() const { return interned(_agg_type); }
+	void agg_type(str_handle agg_type) { _agg_type = agg_type; }
 	val_type_t value_type() const { return _val_type; }
 
 	void value_type(unsigned vt) {
 		_val_type = val_type_t(vt);
-		if (_val_type == i64 && _codec.sign_type() == '+')
+		if (_val_type == i64 && _layout.codec().sign_type() == '+')
 			_val_type = u64;
 	}
 
 	uint64_t decode(uint64_t data) const {
-		return _codec((uint8_t*)&data);
+		return _layout.decode(data);
 	}
 
 	uint64_t encode(uint64_t raw) const {
-		uint64_t rv = 0;
-		_codec(raw, (void*)&rv);
-		return rv;
+		return _layout.encode(raw);
 	}
+
+	bool operator==(const tr_signal&) const = default;
 };
 
 class tr_muxer {
@@ -81,7 +97,7 @@ public:
 	tr_muxer(sig_codec codec) : _codec(codec) {}
 
 	uint64_t decode(uint64_t data) const {
-		return _codec((uint8_t*)&data);
+		return _codec.decode(data);
 	}
 	
 	uint64_t encode(uint64_t raw) const {
@@ -89,58 +105,92 @@ public:
 		_codec(raw, (void*)&rv);
 		return rv;
 	}
+
+	bool operator==(const tr_muxer&) const = default;
 };
 
-class tr_message;
+// A CAN ID can mean different messages on different buses, so messages are identified by both.
+inline uint64_t bus_msg_key(uint8_t bus, canid_t message_id) {
+	return (uint64_t(bus) << 32) | message_id;
+}
+
+// What a loaded transcoder takes in memory, see v2c_transcoder::footprint(). Heap bytes
+// are counted from container capacities, without the allocator's own overhead.
+struct v2c_footprint {
+	size_t messages = 0;
+	size_t signals = 0;
+	size_t groups = 0;
+
+	size_t message_bytes = 0; // the per-bus message maps and the tr_messages in them
+	size_t signal_bytes = 0;  // tr_signals: layouts, value types and name handles, and the aggregated ones
+	size_t group_bytes = 0;   // tx_groups and the records they publish
+	size_t schema_bytes = 0;  // the v2c_schema compiled by the first transcode()
+	size_t state_bytes = 0;   // the v2c_session: windows, aggregated values, timers, metrics and the packet
+	size_t string_bytes = 0;  // the transcoder's string_table, which only grows until it's freed with it
+
+	size_t total() const {
+		return message_bytes + signal_bytes + group_bytes + schema_bytes + state_bytes + string_bytes;
+	}
+};
 
 class tx_group {
-	struct stamped_msg {
-		can_time stamp;
+	// a message, or a multiplexer value of one, in the group's published records
+	struct slot {
 		canid_t message_id;
+		uint8_t bus;
 		int64_t message_mux;
-		uint64_t mdata;
 	};
 
 	std::string _name;
 	std::chrono::milliseconds _assemble_freq;
-	can_time _group_origin;
-
-	std::vector<stamped_msg> _msg_clumps;
+	std::vector<slot> _slots;
 
 	friend class tr_message;
+	friend class v2c_schema;
 public:
 	tx_group(std::string_view name, uint32_t assemble_freq) :
 		_name(name), _assemble_freq(assemble_freq)
 	{}
 
 	std::string_view name() const { return _name; }
-	void time_begin(can_time tp) { _group_origin = tp; }
-	void try_publish(can_time up_to, frame_packet& fp);
+	void footprint(v2c_footprint& rv) const;
 
 private:
-	void publish(can_time tp, frame_packet& fp);
-	bool all_collected() const;
-	void assign(canid_t message_id, int64_t message_mux);
-	bool within_interval(can_time stamp) const;
-	void add_clumped(can_time stamp, canid_t message_id, int64_t message_mux, uint64_t cval);
+	void assign(uint8_t bus, canid_t message_id, int64_t message_mux);
 };
 
 class tr_message {
 	std::vector<tr_signal> _signals;
 	std::optional<tr_muxer> _mux;
 
-	std::vector<sig_asm> _sig_asms;
+	// hashes of the signal names to indices into _signals, for the lookups made while loading
+	// the DBC; extended on lookup with the signals added since, and dropped once it's loaded
+	std::unordered_multimap<size_t, size_t> _sig_index;
+	static constexpr size_t linear_search_max = 8;
+
+	// the aggregated signals, as they were when the message was grouped, as agg and value types may change after
+	struct agg_def {
+		uint32_t sig;
+		bool avg;
+		val_type_t val_type;
+	};
+	std::vector<agg_def> _agg_defs;
 	tx_group* _tx_group = nullptr;
-	can_time _last_stamp;
 
+	friend class v2c_schema;
 public:
-	void assign_group(tx_group* txg, uint32_t message_id);
-	void assemble(can_time stamp, can_frame frame);
+	void assign_group(tx_group* txg, uint32_t message_id, uint8_t bus = 0);
+	tx_group* group() const { return _tx_group; }
+	bool grouped() const { return _tx_group != nullptr; }
 
-	void sig_agg_type(const std::string& sig_name, const std::string& agg_type);
-	void sig_val_type(const std::string& sig_name, unsigned sig_ext_val_type);
+	void sig_agg_type(std::string_view sig_name, str_handle agg_type);
+	void sig_val_type(std::string_view sig_name, unsigned sig_ext_val_type);
 	void add_signal(tr_signal sig);
 	void add_muxer(tr_muxer mux);
+	void reserve_signals(size_t n) { _signals.reserve(n); }
+	size_t signal_count() const { return _signals.size(); }
+	void drop_index() { _sig_index = {}; }
+	void footprint(v2c_footprint& rv) const;
 
 	auto signals(uint64_t fd) const {
 		uint64_t frame_mux = _mux.has_value() ? _mux->decode(fd) : -1;
@@ -149,80 +199,86 @@ public:
 		});
 	}
 private:
-	void make_sig_assemblers();
-	void reset_sig_asms();
-	tr_signal* find_signal(const std::string& sig_name);
+	void make_agg_defs();
+	tr_signal* find_signal(std::string_view sig_name);
 	std::vector<uint64_t> distinct_mux_vals() const;
 };
 
-class vin_assembler {
-	static constexpr size_t vin_len = 17; // industry standard
-	uint32_t _vin_msg_id;
-	uint32_t _cbits = 0;
-	char _vin[vin_len];
-public:
-	bool empty() const {
-		return _cbits != ((1 << vin_len) - 1);
-	}
-	std::string value() const {
-		return empty() ? std::string{} : std::string{ _vin, _vin + vin_len };
-	}
-	void vin_message_id(uint32_t id) {
-		_vin_msg_id = id;
-	}
-
-	bool decode_some(const can::tr_message& msg, can_frame frame);
-private:
-	static int vin_char(std::string_view sig_name);
-};
+class v2c_session;
 
+// The DBCs loaded, and the v2c_session transcoding with them, see v2c_session.h. Load all DBCs
+// before the first transcode(), which compiles them, and reload() them after.
 class v2c_transcoder {
-	std::chrono::milliseconds _publish_freq;
+	std::chrono::milliseconds _publish_freq{ 0 };
 	std::chrono::milliseconds _update_freq{ 0 }; // gcd of all tx_groups' freqs
 
-	std::unordered_map<canid_t, tr_message> _msgs;
+	std::vector<std::unordered_map<canid_t, tr_message>> _msgs; // per bus
+	uint8_t _loading_bus = 0; // the bus whose DBC is being parsed
 	std::vector<std::unique_ptr<tx_group>> _tx_groups;
-	vin_assembler _vin;
+	std::unordered_map<std::string_view, tx_group*> _tx_groups_by_name;
+	size_t _sigs_per_msg = 0; // from the def_counts hint
+	std::optional<uint64_t> _vin_key; // bus_msg_key() of the VIN message
+	std::unique_ptr<string_table> _strings = std::make_unique<string_table>(); // names of the signals and aggregations
 
-	frame_packet _frame_packet;
-	can_time _last_update_tp;
-public:
-	frame_packet transcode(can_time stamp, can_frame frame);
-	std::string vin() const { return _vin.value(); }
+	std::unique_ptr<v2c_session> _session; // with metrics, from the first transcode() on
 
-	void assign_tx_group(const std::string& object_type, unsigned message_id, const std::string& tx_group);
+	friend class v2c_sharded_transcoder;
+	friend class v2c_schema;
+public:
+	v2c_transcoder();
+	~v2c_transcoder();
+	v2c_transcoder(v2c_transcoder&&);
+	v2c_transcoder& operator=(v2c_transcoder&&);
+
+	frame_packet transcode(can_time stamp, can_frame frame, uint8_t bus = 0);
+	frame_packet flush();
+	std::string vin() const;
+	v2c_metrics_snapshot metrics_snapshot() const;
+	v2c_footprint footprint() const;
+
+	bool load_dbc(std::string_view dbc_src, uint8_t bus = 0);
+	bool reload(std::string_view dbc_src);
+	bool reload(std::span<const std::string_view> dbc_srcs);
+	void reload(v2c_transcoder&& next);
+
+	void assign_tx_group(std::string_view object_type, unsigned message_id, std::string_view tx_group);
 	void add_signal(canid_t message_id, tr_signal sig);
 	void add_muxer(canid_t message_id, tr_muxer mux);
 	void add_message(canid_t message_id, std::string_view message_name);
+	void reserve(size_t messages, size_t signals);
+
+	void set_env_var(std::string_view name, int64_t ev_value);
+	void set_sig_val_type(canid_t message_id, std::string_view sig_name, unsigned sig_ext_val_type);
+	void set_sig_agg_type(canid_t message_id, std::string_view sig_name, std::string_view agg_type);
 
-	void set_env_var(const std::string& name, int64_t ev_value);
-	void set_sig_val_type(canid_t message_id, const std::string& sig_name, unsigned sig_ext_val_type);
-	void set_sig_agg_type(canid_t message_id, const std::string& sig_name, const std::string& agg_type);
-	
-	void setup_timers(can_time first_stamp);
-	void store_assembled(can_time up_to);
 	tr_message* find_message(canid_t message_id);
+	tr_message* find_message(uint8_t bus, canid_t message_id);
+	string_table& strings() { return *_strings; }
+
+private:
+	v2c_session& session();
 };
 
-// tag-invokes used by dbc_parser.cpp
+// tag-invokes used by dbc_parser.cpp; the view callbacks don't copy the names of signals
+// and attributes the transcoder ignores
 
 inline void tag_invoke(
-	def_sg_cpo, v2c_transcoder& this_,
-	uint32_t message_id, std::optional<unsigned> sg_mux_switch_val, std::string sg_name,
+	def_sg_view_cpo, v2c_transcoder& this_,
+	uint32_t message_id, std::optional<unsigned> sg_mux_switch_val, std::string_view sg_name,
 	unsigned sg_start_bit, unsigned sg_size, char sg_byte_order, char sg_sign,
 	double sg_factor, double sg_offset, double sg_min, double /*sg_max*/,
-	std::string sg_unit, std::vector<size_t> rec_ords
+	std::string_view sg_unit, std::span<const size_t> rec_ords
 ) {
 	sig_codec codec{ sg_start_bit, sg_size, sg_byte_order, sg_sign };
-	tr_signal sig{ sg_name, codec, std::optional<int64_t>(sg_mux_switch_val) };
+	tr_signal sig{ this_.strings(), sg_name, codec, std::optional<int64_t>(sg_mux_switch_val) };
 	this_.add_signal(message_id, std::move(sig));
 }
 
 inline void tag_invoke(
-	def_sg_mux_cpo, v2c_transcoder& this_,
-	uint32_t message_id, std::string sg_name,
+	def_sg_mux_view_cpo, v2c_transcoder& this_,
+	uint32_t message_id, std::string_view sg_name,
 	unsigned sg_start_bit, unsigned sg_size, char sg_byte_order, char sg_sign,
-	std::string sg_unit, std::vector<size_t> rec_ords
+	std::string_view sg_unit, std::span<const size_t> rec_ords
 ) {
 	sig_codec codec{ sg_start_bit, sg_size, sg_byte_order, sg_sign };
 	tr_muxer mux{ codec };
@@ -230,37 +286,43 @@ inline void tag_invoke(
 }
 
 inline void tag_invoke(
-	def_bo_cpo, v2c_transcoder& this_,
-	uint32_t message_id, std::string msg_name, size_t msg_size, size_t transmitter_ord
+	def_counts_view_cpo, v2c_transcoder& this_,
+	size_t messages, size_t signals
+) {
+	this_.reserve(messages, signals);
+}
+
+inline void tag_invoke(
+	def_bo_view_cpo, v2c_transcoder& this_,
+	uint32_t message_id, std::string_view msg_name, size_t msg_size, size_t transmitter_ord
 ) {
-	this_.add_message(message_id, std::move(msg_name));
+	this_.add_message(message_id, msg_name);
 }
 
 inline void tag_invoke(
-	def_ev_cpo, v2c_transcoder& this_,
-	std::string name, unsigned type, double ev_min, double ev_max,
-	std::string unit, double initial, unsigned ev_id,
-	std::string access_type, std::vector<size_t> access_nodes_ords
+	def_ev_view_cpo, v2c_transcoder& this_,
+	std::string_view name, unsigned type, double ev_min, double ev_max,
+	std::string_view unit, double initial, unsigned ev_id,
+	std::string_view access_type, std::span<const size_t> access_nodes_ords
 ) {
 	this_.set_env_var(name, initial);
 }
 
 inline void tag_invoke(
-	def_ba_cpo, v2c_transcoder& this_,
-	std::string attr_name, std::string object_type, std::string object_name,
-	size_t bu_id, unsigned message_id,
-	std::variant<int32_t, double, std::string> attr_val
+	def_ba_view_cpo, v2c_transcoder& this_,
+	std::string_view attr_name, std::string_view object_type, std::string_view object_name,
+	size_t bu_id, unsigned message_id, attr_value_view attr_val
 ) {
 	if (attr_name == "AggType" && attr_val.index() == 2)
-		this_.set_sig_agg_type(message_id, object_name, std::get<std::string>(attr_val));
+		this_.set_sig_agg_type(message_id, object_name, std::get<std::string_view>(attr_val));
 
 	if (attr_name == "TxGroupFreq" && object_type == "BO_")
-		this_.assign_tx_group(object_type, message_id, std::get<std::string>(attr_val));
+		this_.assign_tx_group(object_type, message_id, std::get<std::string_view>(attr_val));
 }
 
 inline void tag_invoke(
-	def_sig_valtype_cpo, v2c_transcoder& this_,
-	unsigned message_id, std::string sig_name, unsigned sig_ext_val_type
+	def_sig_valtype_view_cpo, v2c_transcoder& this_,
+	unsigned message_id, std::string_view sig_name, unsigned sig_ext_val_type
 ) {
 	this_.set_sig_val_type(message_id, sig_name, sig_ext_val_type);
 }